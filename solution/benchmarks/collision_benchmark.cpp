@@ -0,0 +1,166 @@
+#include "../src/domain_model/collision_detector.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using namespace collision_detector;
+using Clock = std::chrono::steady_clock;
+
+class VectorProvider : public ItemGathererProvider {
+public:
+    std::vector<Item> items;
+    std::vector<Gatherer> gatherers;
+
+    size_t ItemsCount() const override {
+        return items.size();
+    }
+    Item GetItem(size_t idx) const override {
+        return items[idx];
+    }
+    size_t GatherersCount() const override {
+        return gatherers.size();
+    }
+    Gatherer GetGatherer(size_t idx) const override {
+        return gatherers[idx];
+    }
+};
+
+class ArrayProvider : public VectorProvider {
+public:
+    explicit ArrayProvider(VectorProvider other)
+        : VectorProvider(std::move(other)) {
+        for (const Item& item : items) {
+            x.push_back(item.position.x);
+            y.push_back(item.position.y);
+            width.push_back(item.width);
+        }
+    }
+
+    std::optional<ItemsView> GetItemsView() const override {
+        return ItemsView{x.data(), y.data(), width.data(), x.size()};
+    }
+
+    std::vector<double> x;
+    std::vector<double> y;
+    std::vector<double> width;
+};
+
+// Один тик на карте 1000 x 1000: собаки со скоростью 3 за 50 мс сдвигаются
+// вдоль дороги на 0.15, ширина собаки 0.6, предмета 0
+ArrayProvider MakeTick(size_t dogs_count, size_t loot_count) {
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<double> coord(0, 1000);
+    std::bernoulli_distribution horizontal;
+
+    VectorProvider provider;
+    for (size_t i = 0; i < loot_count; ++i) {
+        provider.items.push_back({{coord(rng), coord(rng)}, 0.});
+    }
+    for (size_t i = 0; i < dogs_count; ++i) {
+        geom::Point2D start{coord(rng), coord(rng)};
+        geom::Point2D end = horizontal(rng) ? geom::Point2D{start.x + 0.15, start.y} : geom::Point2D{start.x, start.y + 0.15};
+        provider.gatherers.push_back({start, end, 0.6});
+    }
+    return ArrayProvider(std::move(provider));
+}
+
+template <typename Fn>
+double MeasureMs(Fn&& fn) {
+    auto start = Clock::now();
+    fn();
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+bool IsSameEvents(const std::vector<GatheringEvent>& lhs, const std::vector<GatheringEvent>& rhs) {
+    return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(),
+                      [](const GatheringEvent& l, const GatheringEvent& r) {
+                          return l.item_id == r.item_id && l.gatherer_id == r.gatherer_id
+                              && l.sq_distance == r.sq_distance && l.time == r.time;
+                      });
+}
+
+}  // namespace
+
+int main() {
+    std::cout << std::setw(8) << "dogs" << std::setw(8) << "loot" << std::setw(14) << "brute, ms"
+              << std::setw(14) << "grid, ms" << std::setw(14) << "grid+view, ms" << std::setw(10) << "events" << std::endl;
+
+    for(auto [dogs_count, loot_count] : {std::pair<size_t, size_t>{100, 1'000}, {2'000, 10'000}, {10'000, 50'000}}) {
+        const ArrayProvider provider = MakeTick(dogs_count, loot_count);
+        // Тот же мир без блока предметов: FindGatherEvents копирует их через GetItem
+        const VectorProvider plain_provider = provider;
+
+        std::vector<GatheringEvent> brute_events;
+        std::vector<GatheringEvent> grid_events;
+        std::vector<GatheringEvent> view_events;
+        double brute_ms = MeasureMs([&] {
+            brute_events = FindGatherEventsBruteForce(plain_provider);
+        });
+        double grid_ms = MeasureMs([&] {
+            grid_events = FindGatherEvents(plain_provider);
+        });
+        double view_ms = MeasureMs([&] {
+            view_events = FindGatherEvents(provider);
+        });
+
+        if(!IsSameEvents(brute_events, grid_events) || !IsSameEvents(brute_events, view_events)) {
+            std::cerr << "Grid events differ from brute force for " << dogs_count << " dogs" << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        std::cout << std::setw(8) << dogs_count << std::setw(8) << loot_count << std::setw(14) << std::fixed
+                  << std::setprecision(3) << brute_ms << std::setw(14) << grid_ms << std::setw(14) << view_ms
+                  << std::setw(10) << grid_events.size() << std::endl;
+    }
+
+    // Узкая фаза отдельно: один отрезок против всех предметов подряд,
+    // TryCollectPoint по одному и TryCollectPoints блоками
+    std::cout << std::endl << std::setw(10) << "items" << std::setw(14) << "point, ms" << std::setw(14) << "batch, ms"
+              << std::setw(10) << "collected" << std::endl;
+    for(size_t loot_count : {10'000, 1'000'000}) {
+        const ArrayProvider provider = MakeTick(0, loot_count);
+        const ItemsView items = *provider.GetItemsView();
+        const geom::Point2D a{0, 500};
+        const geom::Point2D b{1000, 500};
+        constexpr int REPEATS = 20;
+
+        size_t point_collected = 0;
+        double point_ms = MeasureMs([&] {
+            for(int r = 0; r < REPEATS; ++r) {
+                for(size_t i = 0; i < items.count; ++i) {
+                    point_collected += TryCollectPoint(a, b, {items.x[i], items.y[i]}).IsCollected(0.6 + items.width[i]);
+                }
+            }
+        });
+
+        size_t batch_collected = 0;
+        double batch_ms = MeasureMs([&] {
+            CollectionBatch batch;
+            for(int r = 0; r < REPEATS; ++r) {
+                for(size_t first = 0; first < items.count; first += COLLECT_BATCH_SIZE) {
+                    const ItemsView part{items.x + first, items.y + first, items.width + first,
+                                         std::min(COLLECT_BATCH_SIZE, items.count - first)};
+                    batch_collected += std::popcount(TryCollectPoints(a, b, 0.6, part, batch));
+                }
+            }
+        });
+
+        if(point_collected != batch_collected) {
+            std::cerr << "Batch collection differs from TryCollectPoint for " << loot_count << " items" << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        std::cout << std::setw(10) << loot_count << std::setw(14) << point_ms / REPEATS << std::setw(14)
+                  << batch_ms / REPEATS << std::setw(10) << batch_collected / REPEATS << std::endl;
+    }
+}
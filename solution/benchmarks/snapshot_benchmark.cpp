@@ -0,0 +1,178 @@
+#include "../src/serialization/model_serialization.h"
+
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+
+using namespace std::literals;
+namespace fs = std::filesystem;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+model::LootType MakeLootType(const std::string& name, int value) {
+    model::LootType loot_type;
+    loot_type.name = name;
+    loot_type.value = value;
+    return loot_type;
+}
+
+model::Map MakeBenchmarkMap(const std::string& id = "bench") {
+    model::Map map(model::Map::Id{id}, "Benchmark map " + id);
+    map.AddRoad(model::Road{model::Road::HORIZONTAL, {0, 0}, 1000});
+    map.AddRoad(model::Road{model::Road::VERTICAL, {1000, 0}, 1000});
+    map.AddRoad(model::Road{model::Road::HORIZONTAL, {0, 1000}, 1000});
+    map.SetDogSpeed(3.);
+    map.SetBagCapacity(3);
+    map.SetLootTypes({MakeLootType("key", 10), MakeLootType("wallet", 30)});
+    map.AddRoadIndexes();
+    return map;
+}
+
+std::string GetMapId(int map_idx) {
+    return map_idx == 0 ? "bench"s : "bench" + std::to_string(map_idx);
+}
+
+// Синтетическая игра: по dogs_count игроков на каждой из maps_count карт, половина
+// из них в движении, и по одному потерянному предмету на каждые два игрока
+model::Game MakeSyntheticGame(int dogs_count, int maps_count = 1) {
+    model::Game game;
+    for(int map_idx = 0; map_idx < maps_count; ++map_idx) {
+        game.AddMap(MakeBenchmarkMap(GetMapId(map_idx)));
+        auto map = game.FindMap(model::Map::Id{GetMapId(map_idx)});
+
+        for(int i = 0; i < dogs_count; ++i) {
+            auto [player, token] = game.JoinGame(map, "player" + std::to_string(i), true);
+            if(i % 2) {
+                game.ApplyPlayerAction(*player, i % 4 == 1 ? "R" : "D");
+            }
+        }
+        game.GetGameSession(map)->GenerateLootObjects(dogs_count / 2);
+    }
+    return game;
+}
+
+model::Game MakeLoadedGame(int maps_count = 1) {
+    model::Game game;
+    for(int map_idx = 0; map_idx < maps_count; ++map_idx) {
+        game.AddMap(MakeBenchmarkMap(GetMapId(map_idx)));
+    }
+    return game;
+}
+
+template <typename Fn>
+double MeasureMs(Fn&& fn) {
+    auto start = Clock::now();
+    fn();
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+}  // namespace
+
+int main() {
+    const fs::path state_file = fs::temp_directory_path() / "snapshot_benchmark.state";
+
+    std::cout << std::setw(8) << "dogs" << std::setw(8) << "format" << std::setw(6) << "zlib"
+              << std::setw(14) << "save, ms" << std::setw(14) << "restore, ms"
+              << std::setw(14) << "size, KiB" << std::endl;
+
+    for(int dogs_count : {1'000, 10'000, 100'000, 1'000'000}) {
+        model::Game game = MakeSyntheticGame(dogs_count);
+        // На миллионе собак (полтора миллиона объектов) сравниваем только
+        // холодный старт из несжатых бинарного и плоского форматов
+        const bool huge = dogs_count > 100'000;
+
+        for(auto [format, name] : {std::pair{model::SnapshotFormat::TEXT, "text"sv},
+                                   std::pair{model::SnapshotFormat::BINARY, "binary"sv},
+                                   std::pair{model::SnapshotFormat::FLAT, "flat"sv}}) {
+            if(huge && format == model::SnapshotFormat::TEXT) {
+                continue;
+            }
+            // Уровень 0 - без сжатия
+            for(int compression_level : {0, 1, 6, 9}) {
+                if(huge && compression_level > 0) {
+                    continue;
+                }
+                const model::SnapshotOptions options{.format = format, .generations = 0, .compression_level = compression_level};
+                double save_ms = MeasureMs([&] {
+                    model::Save(game, state_file.string(), options);
+                });
+                auto size_kib = fs::file_size(state_file) / 1024;
+
+                // Разрушение восстановленной игры в замер не входит
+                model::Game loaded_game = MakeLoadedGame();
+                double restore_ms = MeasureMs([&] {
+                    model::Restore(loaded_game, state_file.string(), options);
+                });
+
+                std::cout << std::setw(8) << dogs_count << std::setw(8) << name << std::setw(6) << compression_level
+                          << std::setw(14) << std::fixed << std::setprecision(1) << save_ms
+                          << std::setw(14) << restore_ms
+                          << std::setw(14) << size_kib << std::endl;
+            }
+        }
+    }
+
+    // Много сессий: блоки сессий кодируются и разбираются параллельно
+    constexpr int maps_count = 16;
+    constexpr int session_dogs_count = 25'000;
+    model::Game game = MakeSyntheticGame(session_dogs_count, maps_count);
+
+    std::cout << std::endl << std::setw(8) << "maps" << std::setw(8) << "format" << std::setw(6) << "zlib"
+              << std::setw(9) << "threads" << std::setw(14) << "save, ms" << std::setw(14) << "restore, ms" << std::endl;
+    for(auto [format, name] : {std::pair{model::SnapshotFormat::BINARY, "binary"sv},
+                               std::pair{model::SnapshotFormat::FLAT, "flat"sv}}) {
+        for(int compression_level : {0, 1}) {
+            for(unsigned threads : {1u, 0u}) {
+                const model::SnapshotOptions options{.format = format, .generations = 0,
+                                                     .compression_level = compression_level, .threads = threads};
+                double save_ms = MeasureMs([&] {
+                    model::Save(game, state_file.string(), options);
+                });
+                model::Game loaded_game = MakeLoadedGame(maps_count);
+                double restore_ms = MeasureMs([&] {
+                    model::Restore(loaded_game, state_file.string(), options);
+                });
+
+                std::cout << std::setw(8) << maps_count << std::setw(8) << name << std::setw(6) << compression_level
+                          << std::setw(9) << (threads ? std::to_string(threads) : "all"s)
+                          << std::setw(14) << std::fixed << std::setprecision(1) << save_ms
+                          << std::setw(14) << restore_ms << std::endl;
+            }
+        }
+    }
+
+    // Пауза игры на снятие полного снимка: копия состояния против закрепления эпохи.
+    // Пока эпоха закреплена, первое изменение собаки копирует её состояние:
+    // сравниваем проход, меняющий всех собак, без закрепления и с ним.
+    std::cout << std::endl << std::setw(8) << "dogs" << std::setw(12) << "copy, ms" << std::setw(12) << "pin, ms"
+              << std::setw(14) << "update, ms" << std::setw(20) << "pinned update, ms" << std::endl;
+    for(int dogs_count : {10'000, 100'000, 1'000'000}) {
+        model::Game game = MakeSyntheticGame(dogs_count);
+        const auto update_dogs = [&game] {
+            for(const auto& [session, players_tokens] : game.GetSessions()) {
+                for(const auto& [token, player] : players_tokens.GetTokenToPlayerMap()) {
+                    player->GetDog()->AddScore(1);
+                }
+            }
+        };
+        double copy_ms = MeasureMs([&] {
+            model::CollectSessionReprs(game);
+        });
+        double update_ms = MeasureMs(update_dogs);
+
+        std::optional<model::PinnedGameState> pinned;
+        double pin_ms = MeasureMs([&] {
+            pinned.emplace(game);
+        });
+        double pinned_update_ms = MeasureMs(update_dogs);
+        pinned.reset();
+
+        std::cout << std::setw(8) << dogs_count << std::setw(12) << std::fixed << std::setprecision(3) << copy_ms
+                  << std::setw(12) << pin_ms << std::setw(14) << update_ms << std::setw(20) << pinned_update_ms << std::endl;
+    }
+    fs::remove(state_file);
+}
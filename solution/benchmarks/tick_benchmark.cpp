@@ -0,0 +1,94 @@
+#include "../src/application_model/game.h"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+
+using namespace std::literals;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+model::LootType MakeLootType(const std::string& name, int value) {
+    model::LootType loot_type;
+    loot_type.name = name;
+    loot_type.value = value;
+    return loot_type;
+}
+
+model::Map MakeBenchmarkMap(const std::string& id) {
+    model::Map map(model::Map::Id{id}, "Benchmark map " + id);
+    map.AddRoad(model::Road{model::Road::HORIZONTAL, {0, 0}, 1000});
+    map.AddRoad(model::Road{model::Road::VERTICAL, {1000, 0}, 1000});
+    map.AddRoad(model::Road{model::Road::HORIZONTAL, {0, 1000}, 1000});
+    map.AddRoad(model::Road{model::Road::VERTICAL, {0, 0}, 1000});
+    map.SetDogSpeed(3.);
+    map.SetBagCapacity(3);
+    map.SetLootTypes({MakeLootType("key", 10), MakeLootType("wallet", 30)});
+    map.AddRoadIndexes();
+    return map;
+}
+
+// maps_count карт по dogs_count собак в движении и по предмету на двух собак
+model::Game MakeTickGame(int maps_count, int dogs_count) {
+    model::Game game;
+    for(int map_idx = 0; map_idx < maps_count; ++map_idx) {
+        const std::string map_id = "bench" + std::to_string(map_idx);
+        game.AddMap(MakeBenchmarkMap(map_id));
+        auto map = game.FindMap(model::Map::Id{map_id});
+        for(int i = 0; i < dogs_count; ++i) {
+            auto [player, token] = game.JoinGame(map, "player" + std::to_string(i), true);
+            const auto& dog = player->GetDog();
+            game.ApplyPlayerAction(*player, i % 2 ? "R" : "U");
+            // Первый отрезок пути начинается в точке появления, а не в начале координат
+            dog->SetGatherer({dog->GetPosition().x, dog->GetPosition().y}, {dog->GetPosition().x, dog->GetPosition().y});
+        }
+        game.GetGameSession(map)->GenerateLootObjects(dogs_count / 2);
+    }
+    return game;
+}
+
+// Средняя длительность тика после одного прогревочного
+double MeasureTickMs(model::Game& game, unsigned threads) {
+    constexpr int TICKS = 10;
+    game.SetTickThreads(threads);
+    game.UpdateGame(0.05);
+
+    const auto start = Clock::now();
+    for(int tick = 0; tick < TICKS; ++tick) {
+        game.UpdateGame(0.05);
+    }
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count() / TICKS;
+}
+
+}  // namespace
+
+int main() {
+    std::cout << "hardware threads: " << std::thread::hardware_concurrency() << std::endl;
+
+    // Много карт: сессии обновляются в разных потоках
+    std::cout << std::setw(8) << "maps" << std::setw(8) << "dogs" << std::setw(10) << "threads"
+              << std::setw(14) << "tick, ms" << std::endl;
+    for(auto [maps_count, dogs_count] : {std::pair{16, 1'000}, {64, 1'000}}) {
+        for(unsigned threads : {1u, 2u, 4u, 8u}) {
+            model::Game game = MakeTickGame(maps_count, dogs_count);
+            const double tick_ms = MeasureTickMs(game, threads);
+            std::cout << std::setw(8) << maps_count << std::setw(8) << dogs_count << std::setw(10) << threads
+                      << std::setw(14) << std::fixed << std::setprecision(3) << tick_ms << std::endl;
+        }
+    }
+
+    // Одна многолюдная карта: собаки двигаются блоками в разных потоках
+    std::cout << std::endl << std::setw(8) << "dogs" << std::setw(10) << "threads" << std::setw(14) << "tick, ms" << std::endl;
+    for(int dogs_count : {20'000, 100'000}) {
+        for(unsigned threads : {1u, 2u, 4u, 8u}) {
+            model::Game game = MakeTickGame(1, dogs_count);
+            const double tick_ms = MeasureTickMs(game, threads);
+            std::cout << std::setw(8) << dogs_count << std::setw(10) << threads << std::setw(14) << std::fixed
+                      << std::setprecision(3) << tick_ms << std::endl;
+        }
+    }
+}
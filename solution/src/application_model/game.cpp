@@ -10,7 +10,7 @@ namespace model {
         throw std::invalid_argument("Map with id "s + *map.GetId() + " already exists"s);
     } else {
         try {
-            maps_.emplace_back(std::move(map));
+            maps_.push_back(std::make_shared<const Map>(std::move(map)));
         } catch (...) {
             map_id_to_index_.erase(it);
             throw;
@@ -22,9 +22,9 @@ const Game::Maps& Game::GetMaps() const noexcept {
     return maps_;
 }
 
-std::shared_ptr<Map> Game::FindMap(const Map::Id& id) const noexcept  {
+std::shared_ptr<const Map> Game::FindMap(const Map::Id& id) const noexcept  {
     if (auto it = map_id_to_index_.find(id); it != map_id_to_index_.end()) {
-        return std::make_shared<Map>(maps_.at(it->second));
+        return maps_[it->second];
     }
     return nullptr;
 }
@@ -34,7 +34,7 @@ std::shared_ptr<GameSession> Game::GetGameSession(const Map::Id& id) {
     return GetGameSession(map);
 }
 
-std::shared_ptr<GameSession> Game::GetGameSession(std::shared_ptr<Map> map) {
+std::shared_ptr<GameSession> Game::GetGameSession(std::shared_ptr<const Map> map) {
     if (map == nullptr) {
         throw std::invalid_argument("Map doesn't exist");
     }
@@ -53,9 +53,9 @@ std::shared_ptr<GameSession> Game::GetGameSession(std::shared_ptr<Map> map) {
 }
 
 void Game::PrintMaps() const {
-    for (Map map : maps_) {
-        std::cout << "Map: " << map.GetName() << std::endl;
-        for (auto road : map.GetRoads()) {
+    for (const auto& map : maps_) {
+        std::cout << "Map: " << map->GetName() << std::endl;
+        for (const auto& road : map->GetRoads()) {
             std::cout << "{" << road.GetStart().x << ", " << road.GetStart().y << "} - {" << road.GetEnd().x << ", " << road.GetEnd().y << "}" << std::endl;
         }
         std::cout << std::endl;
@@ -63,8 +63,21 @@ void Game::PrintMaps() const {
 }
 
 void Game::UpdateGame(double dt) {
+    if(!tick_pool_) {
+        for(auto& [game_session, _] : game_sessions_to_players_tok_) {
+            game_session->UpdateDogsPosition(dt);
+        }
+        return;
+    }
+
+    // Сессии обновляются параллельно, а большие ещё и делят собак между потоками
+
+    tick_sessions_.clear();
     for(auto& [game_session, _] : game_sessions_to_players_tok_) {
-        game_session->UpdateDogsPosition(dt);
+        tick_sessions_.push_back(game_session.get());
     }
+    tick_pool_->Run(tick_sessions_.size(), [this, dt](size_t i) {
+        tick_sessions_[i]->UpdateDogsPosition(dt, tick_pool_.get());
+    });
 }
 }
\ No newline at end of file
@@ -1,21 +1,39 @@
 #pragma once
 #include "../domain_model/model_game.h"
 #include "player_tokens.h"
+#include "../domain_model/tick_pool.h"
+
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <shared_mutex>
 
 namespace model {
 
 class Game {
 public:
-    using Maps = std::vector<Map>;
+    // Карты не меняются после загрузки, поэтому сессии, обработчики и
+    // сериализация делят одни и те же экземпляры
+    using Maps = std::vector<std::shared_ptr<const Map>>;
 
     void AddMap(Map map);
     const Maps& GetMaps() const noexcept;
-    std::shared_ptr<Map> FindMap(const Map::Id& id) const noexcept;
+    std::shared_ptr<const Map> FindMap(const Map::Id& id) const noexcept;
     std::shared_ptr<GameSession> GetGameSession(const Map::Id& id);
-    std::shared_ptr<GameSession> GetGameSession(std::shared_ptr<Map> map);
+    std::shared_ptr<GameSession> GetGameSession(std::shared_ptr<const Map> map);
     void PrintMaps() const;
+    // Сессии независимы, поэтому при числе потоков тика больше одного
+    // обновляются параллельно
     void UpdateGame(double dt);
 
+    // Сколько потоков обновляют сессии в тике (0 - по числу ядер, 1 - последовательно)
+    void SetTickThreads(unsigned threads) {
+        tick_pool_ = threads == 1 ? nullptr : std::make_unique<TickPool>(threads);
+    }
+    unsigned GetTickThreads() const noexcept {
+        return tick_pool_ ? tick_pool_->GetThreads() : 1;
+    }
+
     std::shared_ptr<GameSession> CreateGameSession(const Map::Id& id) {
         auto map = FindMap(id);
 
@@ -39,19 +57,26 @@ public:
             probability)
     {}
 
-    void GenerateLoot(double time_delta_sec) {
-        
+    // Предметы, появившиеся за один тик, по картам
+    using GeneratedLoot = std::pmr::vector<std::pair<Map::Id, std::pmr::vector<std::shared_ptr<LootObject>>>>;
+
+    // Списки размещаются в memory; сервер передаёт арену тика (см. TickArena)
+    GeneratedLoot GenerateLoot(double time_delta_sec,
+                               std::pmr::memory_resource* memory = std::pmr::get_default_resource()) {
+        GeneratedLoot generated(memory);
         for(auto& [session, _] : game_sessions_to_players_tok_) {
-            const std::vector<std::shared_ptr<Dog>> dogs = session->GetDogs();
             int loot_count = session->GetSizeLootObjects();
-            unsigned looter_count = dogs.size();
+            unsigned looter_count = session->GetDogsCount();
             unsigned number = loot_generator_.Generate(std::chrono::milliseconds(static_cast<long long>(time_delta_sec * 1000))
                             , loot_count, looter_count);
-            session->GenerateLootObjects(number);
+            if(number > 0) {
+                generated.emplace_back(session->GetMap()->GetId(), session->GenerateLootObjects(number, memory));
+            }
         }
+        return generated;
     }
 
-    std::pair<std::shared_ptr<model::Player>, model::Token> JoinGame(std::shared_ptr<model::Map> map, const std::string& player_name, bool is_rand_spawn){
+    std::pair<std::shared_ptr<model::Player>, model::Token> JoinGame(std::shared_ptr<const model::Map> map, const std::string& player_name, bool is_rand_spawn){
         std::shared_ptr<model::GameSession> session = GetGameSession(map);
         if (!session) {
             throw std::runtime_error("Failed to create game session.");
@@ -59,54 +84,101 @@ public:
 
         std::shared_ptr<model::Player> player = std::make_shared<model::Player>(player_name);
         player->AddAndPrepareGameSession(session, map, is_rand_spawn);
-        auto token = game_sessions_to_players_tok_[session].AddPlayer(*player);
+        PlayerTokens& players_to_tokens = game_sessions_to_players_tok_[session];
+        auto token = players_to_tokens.AddPlayer(*player);
+        // Возвращается игрок из индекса, а не локальная копия
+        std::shared_ptr<model::Player> added = players_to_tokens.FindPlayer(token);
+        IndexPlayer(token, added);
 
-        return {player, token};
+        return {added, token};
     }
 
+    // Поиск игрока можно вызывать из любого потока, в том числе пока strand игры
+    // добавляет игроков
     std::shared_ptr<const model::Player> FindPlayer(const model::Token& token) const {
-        for(auto& [_, players_to_tokens] : game_sessions_to_players_tok_) {
-            std::shared_ptr<const model::Player> player = players_to_tokens.FindPlayer(token);
-            if(player) {
-                return player;
-            }
-        }
-        return nullptr;
+        std::shared_lock lock(*players_mutex_);
+        auto it = token_to_player_.find(token);
+        return it != token_to_player_.end() ? it->second : nullptr;
     }
 
     std::shared_ptr<const model::Player> FindPlayer(int id) const {
-        for(auto& [_, players_to_tokens] : game_sessions_to_players_tok_) {
-            std::shared_ptr<const model::Player> player = players_to_tokens.FindPlayer(id);
-            if(player) {
-                return player;
-            }
-        }
-        return nullptr;
+        std::shared_lock lock(*players_mutex_);
+        auto it = id_to_player_.find(id);
+        return it != id_to_player_.end() ? it->second : nullptr;
+    }
+
+    // Действие игрока: смена направления его собаки. Одинаково выполняется
+    // для запроса /api/v1/game/player/action и при воспроизведении журнала.
+    void ApplyPlayerAction(const Player& player, const std::string& direction) {
+        player.GetPlayersSession()->SetDogDirection(*player.GetDog(), direction);
     }
 
-    const std::unordered_map<model::Token, std::shared_ptr<model::Player>, model::TokenHasher> GetTokenToPlayerMap(std::shared_ptr<model::GameSession> session) const noexcept {
+    const std::unordered_map<model::Token, std::shared_ptr<model::Player>, model::TokenHasher>& GetTokenToPlayerMap(std::shared_ptr<model::GameSession> session) const noexcept {
+        static const std::unordered_map<model::Token, std::shared_ptr<model::Player>, model::TokenHasher> empty;
         auto it = game_sessions_to_players_tok_.find(session);
         if(it != game_sessions_to_players_tok_.end()) {
             return it->second.GetTokenToPlayerMap();
         }
-        return std::unordered_map<model::Token, std::shared_ptr<model::Player>, model::TokenHasher>();
+        return empty;
     }
 
     std::shared_ptr<model::Player> AddRestoredPlayer(std::shared_ptr<model::GameSession> session, const model::Player& player, model::Token token){
-        return game_sessions_to_players_tok_[session].RestorePlayer(player, token);
+        std::shared_ptr<model::Player> restored = game_sessions_to_players_tok_[session].RestorePlayer(player, token);
+        IndexPlayer(token, restored);
+        return restored;
+    }
+
+    void ReservePlayers(std::shared_ptr<model::GameSession> session, size_t players_count) {
+        game_sessions_to_players_tok_[session].Reserve(players_count);
+        std::lock_guard lock(*players_mutex_);
+        token_to_player_.reserve(token_to_player_.size() + players_count);
+        id_to_player_.reserve(id_to_player_.size() + players_count);
     }
 
     const std::unordered_map<std::shared_ptr<GameSession>, PlayerTokens>& GetSessions() const {
         return game_sessions_to_players_tok_;
     }
+
+    // Эпоха последнего снимка состояния: изменения после неё попадут в следующий дельта-снимок
+    uint64_t GetSnapshotEpoch() const noexcept {
+        return snapshot_epoch_;
+    }
+    void SetSnapshotEpoch(uint64_t epoch) noexcept {
+        snapshot_epoch_ = epoch;
+    }
 private:
     using MapIdToIndex = std::unordered_map<Map::Id, size_t, util::TaggedHasher<Map::Id>>;
 
     MapIdToIndex map_id_to_index_;
-    std::vector<Map> maps_;
+    Maps maps_;
     std::unordered_map<std::shared_ptr<GameSession>, PlayerTokens> game_sessions_to_players_tok_;
+    // Игроки всех сессий по токену и id, чтобы поиск игрока не перебирал сессии
+    std::unordered_map<Token, std::shared_ptr<Player>, TokenHasher> token_to_player_;
+    std::unordered_map<int, std::shared_ptr<Player>> id_to_player_;
+    // Индексы читают потоки запросов вне strand игры. Мьютекс в куче, чтобы
+    // игру можно было перемещать (LoadGame возвращает её по значению).
+    std::unique_ptr<std::shared_mutex> players_mutex_ = std::make_unique<std::shared_mutex>();
 
     loot_gen::LootGenerator loot_generator_;
+    uint64_t snapshot_epoch_ = 0;
+
+    std::unique_ptr<TickPool> tick_pool_;
+    // Сессии текущего тика, переиспользуется между тиками
+    std::vector<GameSession*> tick_sessions_;
+
+    void IndexPlayer(const Token& token, std::shared_ptr<Player> player) {
+        std::lock_guard lock(*players_mutex_);
+        auto [it, inserted] = token_to_player_.try_emplace(token, player);
+        if(!inserted) {
+            // Игрок с тем же токеном заменяется
+            auto old_id = id_to_player_.find(it->second->GetId());
+            if(old_id != id_to_player_.end() && old_id->second == it->second) {
+                id_to_player_.erase(old_id);
+            }
+            it->second = player;
+        }
+        id_to_player_.insert_or_assign(player->GetId(), std::move(player));
+    }
 };
 
 }
\ No newline at end of file
@@ -4,11 +4,11 @@ std::shared_ptr<const model::Player> GameServer::FindPlayer(const model::Token&
     return game_.FindPlayer(token);
 }
 
-std::shared_ptr<model::Map> GameServer::FindMap(const model::Map::Id& id) const noexcept {
+std::shared_ptr<const model::Map> GameServer::FindMap(const model::Map::Id& id) const noexcept {
     return game_.FindMap(id);
 }
 
-const std::vector<model::Map>& GameServer::GetMaps() const noexcept {
+const model::Game::Maps& GameServer::GetMaps() const noexcept {
     return game_.GetMaps();
 }
 
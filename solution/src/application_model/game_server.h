@@ -5,12 +5,19 @@
 #include <utility>
 #include "model_app.h"
 #include <boost/signals2.hpp>
+#include <atomic>
 #include <chrono>
+#include <functional>
 #include <iostream>
+#include <memory>
 #include "player_tokens.h"
 #include "game.h"
+#include "../domain_model/tick_arena.h"
 
 #include "../serialization/model_serialization.h"
+#include "../serialization/snapshot_writer.h"
+#include "../serialization/action_journal.h"
+#include "../latency_histogram.h"
 
 namespace sig = boost::signals2;
 using milliseconds = std::chrono::milliseconds;
@@ -30,33 +37,88 @@ class GameServer {
 
 public:
     using TickSignal = sig::signal<void(milliseconds delta)>;
+    using SnapshotStatsSignal = sig::signal<void(std::string_view phase, const LatencyHistogram& histogram)>;
+    using SnapshotErrorSignal = sig::signal<void(const std::exception& ex)>;
+    using JournalErrorSignal = sig::signal<void(const std::exception& ex)>;
+
+    // Статистика по фазам сохранения отправляется подписчикам каждые SNAPSHOT_STATS_PERIOD снимков
+    static constexpr uint64_t SNAPSHOT_STATS_PERIOD = 16;
 
     GameServer(fs::path config) :
-        game_{json_loader::LoadGame(config)} {
+        game_{json_loader::LoadGame(config)},
+        snapshot_writer_{
+            [this](std::chrono::microseconds encode_time, uint64_t journal_lsn) {
+                // Вызывается только из потока записи
+                if (journal_ && journal_lsn) {
+                    // Записи журнала до journal_lsn уже есть в снимке на диске
+                    model::RemoveJournalSegments(state_file_, journal_lsn);
+                }
+                encode_histogram_.Add(encode_time);
+                if (encode_histogram_.Count() >= SNAPSHOT_STATS_PERIOD) {
+                    snapshot_stats_signal_("encode", encode_histogram_);
+                    encode_histogram_.Reset();
+                }
+            },
+            [this](const std::exception& ex) {
+                need_full_snapshot_ = true;
+                snapshot_error_signal_(ex);
+            }} {
     }
 
-    std::pair<std::shared_ptr<model::Player>, model::Token> JoinGame(std::shared_ptr<model::Map> map, const std::string& player_name) {
+    std::pair<std::shared_ptr<model::Player>, model::Token> JoinGame(std::shared_ptr<const model::Map> map, const std::string& player_name) {
         return game_.JoinGame(map, player_name, is_rand_spawn_);
     }
 
+    // Выполняет действие игрока и пишет его в журнал. Вызывается из api_strand.
+    void ApplyPlayerAction(const model::Player& player, const std::string& direction) {
+        game_.ApplyPlayerAction(player, direction);
+        JournalAction(player, direction);
+    }
+
+    // Запись в журнал действий уже выполненных изменений. Вызываются из api_strand.
+    void JournalJoin(const model::Map::Id& map_id, const model::Player& player, const model::Token& token) {
+        if (journal_) {
+            journal_->Append(model::JoinRecord(map_id, player, token));
+        }
+    }
+
+    void JournalAction(const model::Player& player, const std::string& direction) {
+        if (journal_) {
+            journal_->Append(model::ActionRecord(player.GetId(), direction));
+        }
+    }
+
+    // Вызывает callback, когда записи журнала, сделанные до этого момента, надёжно
+    // сохранены (при --state-journal always), иначе сразу. Можно вызывать из любого потока.
+    void AfterJournalCommit(std::function<void()> callback) {
+        if (journal_) {
+            journal_->WhenCommitted(std::move(callback));
+        } else {
+            callback();
+        }
+    }
+
     std::shared_ptr<const model::Player> FindPlayer(const model::Token& token) const;
     std::shared_ptr<const model::Player> FindPlayer(int id) const {
         return game_.FindPlayer(id);
     }
 
-    const std::unordered_map<model::Token, std::shared_ptr<model::Player>, model::TokenHasher> GetTokenToPlayerMap(std::shared_ptr<model::GameSession> session) const noexcept {
+    const std::unordered_map<model::Token, std::shared_ptr<model::Player>, model::TokenHasher>& GetTokenToPlayerMap(std::shared_ptr<model::GameSession> session) const noexcept {
         return game_.GetTokenToPlayerMap(session);
     }
 
-    std::shared_ptr<model::Map> FindMap(const model::Map::Id& id) const noexcept;
+    std::shared_ptr<const model::Map> FindMap(const model::Map::Id& id) const noexcept;
 
-    const std::vector<model::Map>& GetMaps() const noexcept;
+    const model::Game::Maps& GetMaps() const noexcept;
 
     void Tick2(int tick);
     void Tick2(std::chrono::milliseconds delta);
 
     void SetRandSpawn();
     void SetAutoTick();
+    void SetTickThreads(unsigned threads) {
+        game_.SetTickThreads(threads);
+    }
     bool IsAutoTick() const noexcept;
     bool IsRandomSpawn() const noexcept;
 
@@ -67,19 +129,23 @@ public:
     }
 
     void Tick(milliseconds delta) {
-        // Уведомляем подписчиков сигнала tick
         int millisec_per_sec = 1000;
-        game_.GenerateLoot(delta.count());
-        game_.UpdateGame(static_cast<double>(delta.count())/millisec_per_sec);
-        tick_signal_(delta);
+        {
+            model::Game::GeneratedLoot generated_loot = game_.GenerateLoot(delta.count(), tick_arena_.GetResource());
+            game_.UpdateGame(static_cast<double>(delta.count())/millisec_per_sec);
+            if (journal_) {
+                // Сгенерированные предметы случайны, поэтому пишутся в журнал вместе с тиком
+                journal_->Append(model::TickRecord(delta.count(), generated_loot));
+            }
+            // Уведомляем подписчиков сигнала tick
+            tick_signal_(delta);
+        }
+        // Данные тика к этому моменту разрушены
+        tick_arena_.Reset();
     }
 
     void Tick(int tick) {
-        int millisec_per_sec = 1000;
-        game_.GenerateLoot(tick);
-        game_.UpdateGame(static_cast<double>(tick)/millisec_per_sec);
-        milliseconds delta(tick);
-        tick_signal_(delta);
+        Tick(milliseconds(tick));
     }
 
     void SetStateFile(std::string state_file) {
@@ -90,12 +156,96 @@ public:
         save_state_period_ = save_state_period;
     }
 
-    void Restore() {
-        model::Restore(game_, state_file_);
+    void SetJournalSyncPolicy(model::JournalSyncPolicy policy) {
+        journal_sync_policy_ = policy;
     }
 
+    // Загружает последний снимок и, если включён журнал, повторяет записанные
+    // после него действия. Затем сохраняет полный снимок и начинает журнал заново,
+    // чтобы в нём не оставалось записей, которые не удалось применить.
+    std::optional<std::string> Restore() {
+        std::optional<model::RestoredSnapshot> restored = model::Restore(game_, state_file_, snapshot_options_);
+        if (!journal_sync_policy_) {
+            return restored ? std::optional(restored->filename) : std::nullopt;
+        }
+
+        uint64_t next_lsn = 1;
+        // Снимок без номера записи журнала записан без журнала: повторять нечего
+        if (!restored || restored->journal_lsn != 0) {
+            model::JournalReplayResult replayed = model::ReplayJournal(game_, state_file_, restored ? restored->journal_lsn : 1);
+            next_lsn = replayed.next_lsn;
+            replayed_journal_records_ = replayed.records;
+        }
+        model::Save(game_, state_file_, snapshot_options_, next_lsn);
+        model::RemoveJournalSegments(state_file_);
+        journal_ = std::make_unique<model::ActionJournal>(state_file_, *journal_sync_policy_, next_lsn,
+                                                          [this](const std::exception& ex) {
+                                                              journal_error_signal_(ex);
+                                                          });
+        return restored ? std::optional(restored->filename) : std::nullopt;
+    }
+
+    size_t GetReplayedJournalRecords() const noexcept {
+        return replayed_journal_records_;
+    }
+
+    void SetSnapshotOptions(const model::SnapshotOptions& snapshot_options) {
+        snapshot_options_ = snapshot_options;
+        // Потоки кодирования создаются один раз, а не на каждое периодическое сохранение
+        if (!snapshot_options_.pool) {
+            snapshot_options_.pool = std::make_shared<model::TickPool>(snapshot_options_.threads);
+        }
+    }
+
+    [[nodiscard]] sig::connection DoOnSnapshotStats(const SnapshotStatsSignal::slot_type& handler) {
+        return snapshot_stats_signal_.connect(handler);
+    }
+
+    [[nodiscard]] sig::connection DoOnSnapshotError(const SnapshotErrorSignal::slot_type& handler) {
+        return snapshot_error_signal_.connect(handler);
+    }
+
+    [[nodiscard]] sig::connection DoOnJournalError(const JournalErrorSignal::slot_type& handler) {
+        return journal_error_signal_.connect(handler);
+    }
+
+    // Синхронное сохранение полного снимка, например при завершении работы сервера
     void Save() {
-        model::Save(game_, state_file_);
+        snapshot_writer_.Flush();
+        const uint64_t journal_lsn = journal_ ? journal_->Rotate() : 0;
+        model::Save(game_, state_file_, snapshot_options_, journal_lsn);
+        if (journal_) {
+            model::RemoveJournalSegments(state_file_, journal_lsn);
+        }
+        need_full_snapshot_ = true;
+    }
+
+    // Закрепляет состояние (полный снимок) или снимает копию изменений (дельта) в
+    // текущем потоке (он должен быть api_strand), а сбор, кодирование и запись
+    // в файл передаёт потоку записи. Закрепление не копирует игру, поэтому
+    // полный снимок не останавливает тики на время копирования. Между полными
+    // снимками пишется до snapshot_options_.delta_count дельта-снимков.
+    // Журнал действий переключается на новый сегмент: старые сегменты удаляются,
+    // когда снимок окажется на диске.
+    void SaveAsync() {
+        const auto start = std::chrono::steady_clock::now();
+        const uint64_t journal_lsn = journal_ ? journal_->Rotate() : 0;
+        if (need_full_snapshot_.exchange(false) || deltas_since_full_snapshot_ >= snapshot_options_.delta_count) {
+            model::PinnedGameState pinned(game_);
+            model::ClearDirtyState(game_, pinned.GetEpoch());
+            deltas_since_full_snapshot_ = 0;
+            snapshot_writer_.Write(std::move(pinned), state_file_, snapshot_options_, journal_lsn);
+        } else {
+            std::vector<model::GameSessionDeltaRepr> delta_reprs = model::CollectSessionDeltaReprs(game_);
+            ++deltas_since_full_snapshot_;
+            snapshot_writer_.WriteDelta(std::move(delta_reprs), deltas_since_full_snapshot_, state_file_, snapshot_options_, journal_lsn);
+        }
+
+        capture_histogram_.Add(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start));
+        if (capture_histogram_.Count() >= SNAPSHOT_STATS_PERIOD) {
+            snapshot_stats_signal_("capture", capture_histogram_);
+            capture_histogram_.Reset();
+        }
     }
 
 private:
@@ -105,6 +255,25 @@ private:
     bool is_auto_tick_ = false;
 
     TickSignal tick_signal_;
+    // Временные данные тика
+    model::TickArena tick_arena_;
     std::string state_file_;
+    model::SnapshotOptions snapshot_options_;
     unsigned int save_state_period_ = 0;
+
+    SnapshotStatsSignal snapshot_stats_signal_;
+    SnapshotErrorSignal snapshot_error_signal_;
+    LatencyHistogram capture_histogram_;
+    unsigned deltas_since_full_snapshot_ = 0;
+    // Выставляется из потока записи, если цепочку дельт нужно начать заново
+    std::atomic<bool> need_full_snapshot_ = true;
+    LatencyHistogram encode_histogram_;
+
+    std::optional<model::JournalSyncPolicy> journal_sync_policy_;
+    size_t replayed_journal_records_ = 0;
+    JournalErrorSignal journal_error_signal_;
+    std::unique_ptr<model::ActionJournal> journal_;
+    // Объявлен последним, чтобы поток записи останавливался раньше, чем
+    // разрушаются журнал, гистограммы и сигналы, к которым он обращается
+    model::SnapshotWriter snapshot_writer_;
 };
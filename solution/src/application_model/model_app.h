@@ -23,7 +23,7 @@ public:
     Player(const std::shared_ptr<Dog>& dog, std::string name, int id) : name_(name), id_(id){
         dog_ = dog;
     }
-    void SetIdCounter(int id_counter) {
+    static void SetIdCounter(int id_counter) {
         id_counter_ = id_counter;
     }
 
@@ -35,8 +35,8 @@ public:
     const std::shared_ptr<GameSession> GetPlayersSession() const {return session_;}
     std::shared_ptr<GameSession> GetPlayersSession() {return session_;}
 
-    void AddAndPrepareGameSession(std::shared_ptr<GameSession> session, std::shared_ptr<model::Map> map, bool is_rand_spawn);
-    int GetIdCounter() const {
+    void AddAndPrepareGameSession(std::shared_ptr<GameSession> session, std::shared_ptr<const model::Map> map, bool is_rand_spawn);
+    static int GetIdCounter() {
         return id_counter_;
     }
     void SetSession(const std::shared_ptr<GameSession>& session) {
@@ -22,13 +22,14 @@ using TokenHasher = util::TaggedHasher<Token>;
 
 class PlayerTokens {
 public:
+    using PlayerLog = AppendLog<std::pair<Token, std::shared_ptr<Player>>>;
 
     PlayerTokens() {}
     ~PlayerTokens() {}
 
 
     std::shared_ptr<Player> FindPlayer(int id) const {
-        for(auto [token, player] : token_to_player_) {
+        for(const auto& [token, player] : token_to_player_) {
             if(id == player->GetId()){
                 return player;
             }
@@ -44,16 +45,43 @@ public:
     }
     Token AddPlayer(const Player& player) {
         Token token = GetToken();
-        token_to_player_[token] = std::make_shared<Player>(player);
+        std::shared_ptr<Player> player_ptr = std::make_shared<Player>(player);
+        token_to_player_[token] = player_ptr;
+        AppendToLog(token, std::move(player_ptr));
         return token;
     }
 
     std::shared_ptr<Player> RestorePlayer(const Player& player, Token token) {
         std::shared_ptr<Player> player_ptr = std::make_shared<Player>(player);
-        token_to_player_[token] = player_ptr;
+        auto [it, inserted] = token_to_player_.insert_or_assign(token, player_ptr);
+        if(!inserted) {
+            // Замена игрока - редкость, поэтому индекса по токенам у списка нет
+            for(size_t i = 0; i < player_log_->Size(); ++i) {
+                const PlayerLog::Entry& entry = (*player_log_)[i];
+                if(!entry.IsRemoved() && entry.value->first == token) {
+                    player_log_->Remove(i);
+                    break;
+                }
+            }
+        }
+        AppendToLog(std::move(token), player_ptr);
         return player_ptr;
     }
 
+    void Reserve(size_t players_count) {
+        token_to_player_.reserve(token_to_player_.size() + players_count);
+        if(player_log_->GetCapacity() < player_log_->Size() + players_count) {
+            player_log_ = player_log_->Compact([](const auto&, size_t) {},
+                                               player_log_->Size() - player_log_->GetRemovedCount() + players_count);
+        }
+    }
+
+    // Игроки в порядке добавления вместе с заменёнными. Закреплённый
+    // снимок хранит этот список и читает его в другом потоке.
+    std::shared_ptr<const PlayerLog> GetPlayerLog() const {
+        return player_log_;
+    }
+
     const std::unordered_map<Token, std::shared_ptr<Player>, TokenHasher>& GetTokenToPlayerMap() const {
         return token_to_player_;
     }
@@ -61,6 +89,15 @@ public:
 private:
     
     std::unordered_map<Token, std::shared_ptr<Player>, TokenHasher> token_to_player_;
+    std::shared_ptr<PlayerLog> player_log_ = std::make_shared<PlayerLog>();
+
+    void AppendToLog(Token token, std::shared_ptr<Player> player) {
+        if(player_log_->NeedsCompaction()) {
+            // Старый список остаётся у закреплённых снимков, которые его читают
+            player_log_ = player_log_->Compact([](const auto&, size_t) {});
+        }
+        player_log_->Append({std::move(token), std::move(player)});
+    }
 
     std::random_device random_device_;
     std::mt19937_64 generator1_{[this] {
@@ -10,8 +10,18 @@ struct Args {
     std::string config_file_path;
     std::string root_path;
     std::string state_file_path;
+    std::string state_format = "text";
+    unsigned int state_generations = 2;
+    unsigned int state_delta_count = 0;
+    std::string state_journal = "off";
+    int state_compression = 0;
+    unsigned int state_threads = 0;
     unsigned int save_state_period = 0;
     unsigned int tick_period = 0;
+    unsigned int tick_threads = 1;
+    std::string tick_mode = "delay";
+    unsigned int tick_max_steps = 5;
+    std::string tick_overflow = "merge";
     bool random_spawn = false;
 };
 
@@ -25,10 +35,20 @@ struct Args {
         // Добавляем опцию --help и её короткую версию -h
         ("help,h", "Show help")
         ("tick-period,t",   po::value<unsigned int>(&args.tick_period)->value_name("milliseconds"s), "Set tick period")
+        ("tick-threads",    po::value<unsigned int>(&args.tick_threads)->value_name("count"s), "Set number of threads updating game sessions in a tick (0 - all cores)")
+        ("tick-mode",       po::value(&args.tick_mode)->value_name("delay|fixed"s), "Set tick scheduling mode")
+        ("tick-max-steps",  po::value<unsigned int>(&args.tick_max_steps)->value_name("count"s), "Set max number of catch-up steps per wakeup in fixed tick mode")
+        ("tick-overflow",   po::value(&args.tick_overflow)->value_name("merge|drop"s), "Merge or drop steps beyond tick-max-steps in fixed tick mode")
         ("config-file,c",   po::value(&args.config_file_path)->value_name("file"s), "Set config file path")
         ("www-root,w",      po::value(&args.root_path)->value_name("dir"s), "Set root dir")
         ("randomize-spawn-points", po::value<bool>(&args.random_spawn), "Set random dog spawn")
         ("state-file,st",   po::value(&args.state_file_path)->value_name("state_file"s), "Set state file path")
+        ("state-format",    po::value(&args.state_format)->value_name("text|binary|flat"s), "Set state file format")
+        ("state-generations", po::value<unsigned int>(&args.state_generations)->value_name("count"s), "Set number of previous state files to keep")
+        ("state-delta-count", po::value<unsigned int>(&args.state_delta_count)->value_name("count"s), "Set number of delta snapshots between full ones")
+        ("state-compression", po::value<int>(&args.state_compression)->value_name("level"s), "Set zlib compression level of state files (0 - off)")
+        ("state-threads",   po::value<unsigned int>(&args.state_threads)->value_name("count"s), "Set number of threads encoding state file sessions (0 - all cores)")
+        ("state-journal",   po::value(&args.state_journal)->value_name("off|never|batch|always"s), "Enable action journal with given fsync policy")
         ("save-state-period,sv",   po::value<unsigned int>(&args.save_state_period)->value_name("milliseconds"s), "Set save state period");
 
     // variables_map хранит значения опций после разбора
@@ -49,6 +69,18 @@ struct Args {
     if (!vm.contains("www-root")) {
         throw std::runtime_error("Root dir have not been specified"s);
     } 
+    if (args.tick_mode != "delay"sv && args.tick_mode != "fixed"sv) {
+        throw std::runtime_error("Tick mode must be delay or fixed"s);
+    }
+    if (args.tick_max_steps == 0) {
+        throw std::runtime_error("Tick max steps must be positive"s);
+    }
+    if (args.tick_overflow != "merge"sv && args.tick_overflow != "drop"sv) {
+        throw std::runtime_error("Tick overflow must be merge or drop"s);
+    }
+    if (args.state_compression < 0 || args.state_compression > 9) {
+        throw std::runtime_error("State compression level must be in range 0-9"s);
+    }
 
     return args;
 }
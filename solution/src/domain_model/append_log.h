@@ -0,0 +1,109 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+#include "state_epoch.h"
+
+namespace model {
+
+// Список, в который только дописывают. Записанные элементы не перемещаются, а
+// удаление лишь помечает элемент эпохой удаления. Поэтому первые Size()
+// элементов, запомненные при закреплении эпохи, можно читать из другого потока,
+// пока владелец дописывает и удаляет элементы. Ёмкость фиксирована: когда
+// список заполнится или в нём накопятся удалённые элементы, владелец
+// переписывает его в новый через Compact, а старый остаётся читателям.
+template <typename T>
+class AppendLog {
+    static constexpr size_t CHUNK_SIZE = 1024;
+
+public:
+    struct Entry {
+        // Пуст только у ещё не записанных элементов блока
+        std::optional<T> value;
+        // Эпоха, в которой элемент удалён (StateEpoch::NONE - не удалён)
+        std::atomic<uint64_t> removed_epoch = StateEpoch::NONE;
+
+        bool IsVisibleAt(uint64_t epoch) const noexcept {
+            return removed_epoch.load(std::memory_order_acquire) > epoch;
+        }
+        bool IsRemoved() const noexcept {
+            return removed_epoch.load(std::memory_order_relaxed) != StateEpoch::NONE;
+        }
+    };
+
+    explicit AppendLog(size_t capacity = CHUNK_SIZE)
+        : max_chunks_((capacity + CHUNK_SIZE - 1) / CHUNK_SIZE)
+        , chunks_(std::make_unique<std::unique_ptr<Chunk>[]>(max_chunks_)) {
+    }
+
+    size_t Size() const noexcept {
+        return size_;
+    }
+    size_t GetRemovedCount() const noexcept {
+        return removed_;
+    }
+    size_t GetCapacity() const noexcept {
+        return max_chunks_ * CHUNK_SIZE;
+    }
+    bool IsFull() const noexcept {
+        return size_ == GetCapacity();
+    }
+    // Пора переписать список: он заполнен или больше половины элементов удалено
+    bool NeedsCompaction() const noexcept {
+        return IsFull() || (removed_ >= CHUNK_SIZE && removed_ * 2 >= size_);
+    }
+
+    // Возвращает индекс элемента. Список не должен быть заполнен.
+    size_t Append(T value) {
+        std::unique_ptr<Chunk>& chunk = chunks_[size_ / CHUNK_SIZE];
+        if (!chunk) {
+            chunk = std::make_unique<Chunk>();
+        }
+        (*chunk)[size_ % CHUNK_SIZE].value.emplace(std::move(value));
+        return size_++;
+    }
+
+    void Remove(size_t idx) {
+        At(idx).removed_epoch.store(StateEpoch::Current(), std::memory_order_release);
+        ++removed_;
+    }
+
+    const Entry& operator[](size_t idx) const {
+        return (*chunks_[idx / CHUNK_SIZE])[idx % CHUNK_SIZE];
+    }
+
+    // Новый список из неудалённых элементов с запасом ёмкости на столько же новых
+    // (но не меньше min_capacity). on_moved(value, new_idx) вызывается для
+    // каждого перенесённого элемента.
+    template <typename Fn>
+    std::shared_ptr<AppendLog> Compact(Fn&& on_moved, size_t min_capacity = 0) const {
+        auto compacted = std::make_shared<AppendLog>(std::max({CHUNK_SIZE, (size_ - removed_) * 2, min_capacity}));
+        for (size_t i = 0; i < size_; ++i) {
+            const Entry& entry = (*this)[i];
+            if (!entry.IsRemoved()) {
+                on_moved(*entry.value, compacted->Append(*entry.value));
+            }
+        }
+        return compacted;
+    }
+
+private:
+    using Chunk = std::array<Entry, CHUNK_SIZE>;
+
+    Entry& At(size_t idx) {
+        return (*chunks_[idx / CHUNK_SIZE])[idx % CHUNK_SIZE];
+    }
+
+    size_t max_chunks_;
+    // Массив указателей на блоки не растёт, поэтому его не перевыделяют под читателями
+    std::unique_ptr<std::unique_ptr<Chunk>[]> chunks_;
+    size_t size_ = 0;
+    size_t removed_ = 0;
+};
+
+}  // namespace model
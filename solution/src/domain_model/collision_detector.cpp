@@ -1,63 +1,339 @@
-#undef FindGatherEvents
-
-#include "collision_detector.h"
-#include <cassert>
-
-namespace collision_detector {
-
-CollectionResult TryCollectPoint(geom::Point2D a, geom::Point2D b, geom::Point2D c) {
-    // Проверим, что перемещение ненулевое.
-    // Тут приходится использовать строгое равенство, а не приближённое,
-    // пскольку при сборе заказов придётся учитывать перемещение даже на небольшое
-    // расстояние.
-    assert(b.x != a.x || b.y != a.y);
-    const double u_x = c.x - a.x;
-    const double u_y = c.y - a.y;
-    const double v_x = b.x - a.x;
-    const double v_y = b.y - a.y;
-    const double u_dot_v = u_x * v_x + u_y * v_y;
-    const double u_len2 = u_x * u_x + u_y * u_y;
-    const double v_len2 = v_x * v_x + v_y * v_y;
-    const double proj_ratio = u_dot_v / v_len2;
-    const double sq_distance = u_len2 - (u_dot_v * u_dot_v) / v_len2;
-
-    return CollectionResult(sq_distance, proj_ratio);
-}
-
-std::vector<GatheringEvent> FindGatherEvents(
-    const ItemGathererProvider& provider) {
-    std::vector<GatheringEvent> detected_events;
-
-    static auto eq_pt = [](geom::Point2D p1, geom::Point2D p2) {
-        return p1.x == p2.x && p1.y == p2.y;
-    };
-
-    for (size_t g = 0; g < provider.GatherersCount(); ++g) {
-        Gatherer gatherer = provider.GetGatherer(g);
-        if (eq_pt(gatherer.start_pos, gatherer.end_pos)) {
-            continue;
-        }
-        for (size_t i = 0; i < provider.ItemsCount(); ++i) {
-            Item item = provider.GetItem(i);
-            auto collect_result
-                = TryCollectPoint(gatherer.start_pos, gatherer.end_pos, item.position);
-
-            if (collect_result.IsCollected(gatherer.width + item.width)) {
-                GatheringEvent evt{.item_id = i,
-                                   .gatherer_id = g,
-                                   .sq_distance = collect_result.sq_distance,
-                                   .time = collect_result.proj_ratio};
-                detected_events.push_back(evt);
-            }
-        }
-    }
-
-    std::sort(detected_events.begin(), detected_events.end(),
-              [](const GatheringEvent& e_l, const GatheringEvent& e_r) {
-                  return e_l.time < e_r.time;
-              });
-
-    return detected_events;
-}
-
+#undef FindGatherEvents
+
+#include "collision_detector.h"
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <utility>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define COLLISION_DETECTOR_AVX2
+#include <immintrin.h>
+#endif
+
+namespace collision_detector {
+
+CollectionResult TryCollectPoint(geom::Point2D a, geom::Point2D b, geom::Point2D c) {
+    // Проверим, что перемещение ненулевое.
+    // Тут приходится использовать строгое равенство, а не приближённое,
+    // пскольку при сборе заказов придётся учитывать перемещение даже на небольшое
+    // расстояние.
+    assert(b.x != a.x || b.y != a.y);
+    const double u_x = c.x - a.x;
+    const double u_y = c.y - a.y;
+    const double v_x = b.x - a.x;
+    const double v_y = b.y - a.y;
+    const double u_dot_v = u_x * v_x + u_y * v_y;
+    const double u_len2 = u_x * u_x + u_y * u_y;
+    const double v_len2 = v_x * v_x + v_y * v_y;
+    const double proj_ratio = u_dot_v / v_len2;
+    const double sq_distance = u_len2 - (u_dot_v * u_dot_v) / v_len2;
+
+    return CollectionResult(sq_distance, proj_ratio);
+}
+
+namespace {
+
+// Меньше этого числа предметов сетку строить дороже, чем перебрать все пары
+constexpr size_t GRID_MIN_ITEMS = 32;
+constexpr double MIN_CELL_SIZE = 1.0;
+
+bool IsSamePoint(geom::Point2D p1, geom::Point2D p2) {
+    return p1.x == p2.x && p1.y == p2.y;
+}
+
+void SortByTime(std::vector<GatheringEvent>& events) {
+    std::sort(events.begin(), events.end(), [](const GatheringEvent& e_l, const GatheringEvent& e_r) {
+        return e_l.time < e_r.time;
+    });
+}
+
+// Предметы [first, items.count) по формулам TryCollectPoint
+uint64_t TryCollectPointsScalar(geom::Point2D a, geom::Point2D b, double gatherer_width, ItemsView items,
+                                size_t first, CollectionBatch& result) {
+    uint64_t mask = 0;
+    for (size_t i = first; i < items.count; ++i) {
+        const CollectionResult collect_result = TryCollectPoint(a, b, {items.x[i], items.y[i]});
+        result.sq_distance[i] = collect_result.sq_distance;
+        result.proj_ratio[i] = collect_result.proj_ratio;
+        if (collect_result.IsCollected(gatherer_width + items.width[i])) {
+            mask |= uint64_t{1} << i;
+        }
+    }
+    return mask;
+}
+
+#ifdef COLLISION_DETECTOR_AVX2
+// Те же операции в том же порядке, что и в TryCollectPoint, поэтому результат
+// совпадает до бита. FMA не включается, чтобы компилятор не слил умножения со сложениями.
+__attribute__((target("avx2"))) uint64_t TryCollectPointsAvx2(geom::Point2D a, geom::Point2D b,
+                                                               double gatherer_width, ItemsView items,
+                                                               CollectionBatch& result) {
+    constexpr size_t LANES = 4;
+
+    const __m256d a_x = _mm256_set1_pd(a.x);
+    const __m256d a_y = _mm256_set1_pd(a.y);
+    const double v_x = b.x - a.x;
+    const double v_y = b.y - a.y;
+    const __m256d v_x4 = _mm256_set1_pd(v_x);
+    const __m256d v_y4 = _mm256_set1_pd(v_y);
+    const __m256d v_len2 = _mm256_set1_pd(v_x * v_x + v_y * v_y);
+    const __m256d g_width = _mm256_set1_pd(gatherer_width);
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d one = _mm256_set1_pd(1.0);
+
+    uint64_t mask = 0;
+    size_t i = 0;
+    for (; i + LANES <= items.count; i += LANES) {
+        const __m256d u_x = _mm256_sub_pd(_mm256_loadu_pd(items.x + i), a_x);
+        const __m256d u_y = _mm256_sub_pd(_mm256_loadu_pd(items.y + i), a_y);
+        const __m256d u_dot_v = _mm256_add_pd(_mm256_mul_pd(u_x, v_x4), _mm256_mul_pd(u_y, v_y4));
+        const __m256d u_len2 = _mm256_add_pd(_mm256_mul_pd(u_x, u_x), _mm256_mul_pd(u_y, u_y));
+        const __m256d proj_ratio = _mm256_div_pd(u_dot_v, v_len2);
+        const __m256d sq_distance = _mm256_sub_pd(u_len2, _mm256_div_pd(_mm256_mul_pd(u_dot_v, u_dot_v), v_len2));
+        _mm256_storeu_pd(result.proj_ratio + i, proj_ratio);
+        _mm256_storeu_pd(result.sq_distance + i, sq_distance);
+
+        const __m256d radius = _mm256_add_pd(g_width, _mm256_loadu_pd(items.width + i));
+        const __m256d collected = _mm256_and_pd(
+            _mm256_and_pd(_mm256_cmp_pd(proj_ratio, zero, _CMP_GE_OQ), _mm256_cmp_pd(proj_ratio, one, _CMP_LE_OQ)),
+            _mm256_cmp_pd(sq_distance, _mm256_mul_pd(radius, radius), _CMP_LE_OQ));
+        mask |= static_cast<uint64_t>(_mm256_movemask_pd(collected)) << i;
+    }
+    return mask | TryCollectPointsScalar(a, b, gatherer_width, items, i, result);
+}
+
+bool IsAvx2Supported() {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+#endif
+
+// Предметы провайдера одним блоком: его собственный или скопированный в буферы
+ItemsView GetItems(const ItemGathererProvider& provider, GatherBuffers& buffers) {
+    if (std::optional<ItemsView> view = provider.GetItemsView()) {
+        return *view;
+    }
+    buffers.items_x.clear();
+    buffers.items_y.clear();
+    buffers.items_width.clear();
+    for (size_t i = 0; i < provider.ItemsCount(); ++i) {
+        const Item item = provider.GetItem(i);
+        buffers.items_x.push_back(item.position.x);
+        buffers.items_y.push_back(item.position.y);
+        buffers.items_width.push_back(item.width);
+    }
+    return {buffers.items_x.data(), buffers.items_y.data(), buffers.items_width.data(), buffers.items_x.size()};
+}
+
+// Добавляет события сбора предметов блока, item_id - номер предмета в блоке
+void CollectFromBlock(const Gatherer& gatherer, size_t gatherer_id, ItemsView block,
+                      std::vector<GatheringEvent>& events) {
+    CollectionBatch batch;
+    for (size_t first = 0; first < block.count; first += COLLECT_BATCH_SIZE) {
+        const ItemsView part{block.x + first, block.y + first, block.width + first,
+                             std::min(COLLECT_BATCH_SIZE, block.count - first)};
+        uint64_t mask = TryCollectPoints(gatherer.start_pos, gatherer.end_pos, gatherer.width, part, batch);
+        for (; mask != 0; mask &= mask - 1) {
+            const size_t k = std::countr_zero(mask);
+            events.push_back({.item_id = first + k,
+                              .gatherer_id = gatherer_id,
+                              .sq_distance = batch.sq_distance[k],
+                              .time = batch.proj_ratio[k]});
+        }
+    }
+}
+
+// Равномерная сетка по позициям предметов в массивах GatherBuffers. Предметы
+// переложены по клеткам, так что предметы клетки - непрерывный блок.
+class ItemGrid {
+public:
+    ItemGrid(ItemsView items, double cell_size, GatherBuffers& buffers)
+        : cell_size_(cell_size)
+        , cell_items_(buffers.cell_items)
+        , cells_(buffers.cells) {
+        cell_items_.clear();
+        for (size_t i = 0; i < items.count; ++i) {
+            cell_items_.emplace_back(GetCellKey(GetCell(items.x[i]), GetCell(items.y[i])), i);
+        }
+        // Внутри клетки предметы остаются по возрастанию номера
+        std::sort(cell_items_.begin(), cell_items_.end());
+
+        buffers.cell_items_x.clear();
+        buffers.cell_items_y.clear();
+        buffers.cell_items_width.clear();
+        cells_.clear();
+        for (size_t k = 0; k < cell_items_.size(); ++k) {
+            const auto [key, idx] = cell_items_[k];
+            if (cells_.empty() || cells_.back().first != key) {
+                cells_.emplace_back(key, k);
+            }
+            buffers.cell_items_x.push_back(items.x[idx]);
+            buffers.cell_items_y.push_back(items.y[idx]);
+            buffers.cell_items_width.push_back(items.width[idx]);
+        }
+        items_ = {buffers.cell_items_x.data(), buffers.cell_items_y.data(), buffers.cell_items_width.data(),
+                  cell_items_.size()};
+    }
+
+    // Добавляет события сбора предметов, которые лежат в прямоугольнике [min, max]
+    // (и, возможно, некоторых соседних), в порядке возрастания номера предмета
+    void Collect(const Gatherer& gatherer, size_t gatherer_id, geom::Point2D min, geom::Point2D max,
+                 std::vector<GatheringEvent>& events) const {
+        const size_t first_event = events.size();
+        const int64_t x0 = GetCell(min.x), x1 = GetCell(max.x);
+        const int64_t y0 = GetCell(min.y), y1 = GetCell(max.y);
+
+        // Длинный отрезок накрывает больше клеток, чем есть непустых: дешевле
+        // проверить все предметы подряд
+        if (static_cast<double>(x1 - x0 + 1) * static_cast<double>(y1 - y0 + 1) > static_cast<double>(cells_.size())) {
+            CollectFrom(gatherer, gatherer_id, 0, items_.count, events);
+        } else {
+            for (int64_t x = x0; x <= x1; ++x) {
+                for (int64_t y = y0; y <= y1; ++y) {
+                    const CellKey key = GetCellKey(x, y);
+                    auto it = std::lower_bound(cells_.begin(), cells_.end(), key, [](const auto& cell, CellKey key) {
+                        return cell.first < key;
+                    });
+                    if (it != cells_.end() && it->first == key) {
+                        const size_t last = std::next(it) == cells_.end() ? items_.count : std::next(it)->second;
+                        CollectFrom(gatherer, gatherer_id, it->second, last, events);
+                    }
+                }
+            }
+        }
+        std::sort(events.begin() + first_event, events.end(), [](const GatheringEvent& e_l, const GatheringEvent& e_r) {
+            return e_l.item_id < e_r.item_id;
+        });
+    }
+
+private:
+    // Координаты клетки, упакованные в одно число. Клетки дальше 2^31 от начала
+    // координат склеиваются с другими, что даёт лишних кандидатов, но не теряет предметы.
+    using CellKey = uint64_t;
+
+    int64_t GetCell(double coord) const {
+        return static_cast<int64_t>(std::floor(coord / cell_size_));
+    }
+    static CellKey GetCellKey(int64_t x, int64_t y) {
+        return (static_cast<CellKey>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(y);
+    }
+
+    // Предметы [first, last) в порядке клеток
+    void CollectFrom(const Gatherer& gatherer, size_t gatherer_id, size_t first, size_t last,
+                     std::vector<GatheringEvent>& events) const {
+        const size_t first_event = events.size();
+        CollectFromBlock(gatherer, gatherer_id, {items_.x + first, items_.y + first, items_.width + first, last - first},
+                         events);
+        for (size_t e = first_event; e < events.size(); ++e) {
+            events[e].item_id = cell_items_[first + events[e].item_id].second;
+        }
+    }
+
+    double cell_size_;
+    // (клетка, номер предмета у провайдера) по клеткам
+    std::vector<std::pair<CellKey, size_t>>& cell_items_;
+    // Непустые клетки по возрастанию: (клетка, начало её блока)
+    std::vector<std::pair<CellKey, size_t>>& cells_;
+    ItemsView items_;
+};
+
+}  // namespace
+
+uint64_t TryCollectPoints(geom::Point2D a, geom::Point2D b, double gatherer_width, ItemsView items,
+                          CollectionBatch& result) {
+    assert(items.count <= COLLECT_BATCH_SIZE);
+#ifdef COLLISION_DETECTOR_AVX2
+    if (IsAvx2Supported()) {
+        return TryCollectPointsAvx2(a, b, gatherer_width, items, result);
+    }
+#endif
+    return TryCollectPointsScalar(a, b, gatherer_width, items, 0, result);
+}
+
+std::vector<GatheringEvent> FindGatherEventsBruteForce(const ItemGathererProvider& provider) {
+    std::vector<GatheringEvent> detected_events;
+
+    for (size_t g = 0; g < provider.GatherersCount(); ++g) {
+        Gatherer gatherer = provider.GetGatherer(g);
+        if (IsSamePoint(gatherer.start_pos, gatherer.end_pos)) {
+            continue;
+        }
+        for (size_t i = 0; i < provider.ItemsCount(); ++i) {
+            Item item = provider.GetItem(i);
+            auto collect_result
+                = TryCollectPoint(gatherer.start_pos, gatherer.end_pos, item.position);
+
+            if (collect_result.IsCollected(gatherer.width + item.width)) {
+                GatheringEvent evt{.item_id = i,
+                                   .gatherer_id = g,
+                                   .sq_distance = collect_result.sq_distance,
+                                   .time = collect_result.proj_ratio};
+                detected_events.push_back(evt);
+            }
+        }
+    }
+
+    SortByTime(detected_events);
+    return detected_events;
+}
+
+std::vector<GatheringEvent> FindGatherEvents(
+    const ItemGathererProvider& provider) {
+    GatherBuffers buffers;
+    FindGatherEvents(provider, buffers);
+    return std::move(buffers.events);
+}
+
+const std::vector<GatheringEvent>& FindGatherEvents(const ItemGathererProvider& provider, GatherBuffers& buffers) {
+    const ItemsView items = GetItems(provider, buffers);
+
+    std::vector<Gatherer>& gatherers = buffers.gatherers;
+    gatherers.clear();
+    double max_gatherer_width = 0;
+    for (size_t g = 0; g < provider.GatherersCount(); ++g) {
+        const Gatherer& gatherer = gatherers.emplace_back(provider.GetGatherer(g));
+        max_gatherer_width = std::max(max_gatherer_width, gatherer.width);
+    }
+
+    std::vector<GatheringEvent>& detected_events = buffers.events;
+    detected_events.clear();
+    if (items.count < GRID_MIN_ITEMS) {
+        for (size_t g = 0; g < gatherers.size(); ++g) {
+            if (!IsSamePoint(gatherers[g].start_pos, gatherers[g].end_pos)) {
+                CollectFromBlock(gatherers[g], g, items, detected_events);
+            }
+        }
+        SortByTime(detected_events);
+        return detected_events;
+    }
+
+    const double max_item_width = *std::max_element(items.width, items.width + items.count);
+    // Клетка не меньше диаметра сбора: за тик собака затрагивает лишь несколько клеток
+    const ItemGrid grid(items, std::max(MIN_CELL_SIZE, 2 * (max_item_width + max_gatherer_width)), buffers);
+
+    for (size_t g = 0; g < gatherers.size(); ++g) {
+        const Gatherer& gatherer = gatherers[g];
+        if (IsSamePoint(gatherer.start_pos, gatherer.end_pos)) {
+            continue;
+        }
+        // Собранный предмет не дальше радиуса сбора от отрезка, значит, лежит в его
+        // рамке, расширенной на этот радиус. События каждой собаки идут по возрастанию
+        // номера предмета, поэтому попадают в сортировку в том же порядке, что и при
+        // полном переборе, и равные по времени не переставляются иначе.
+        const double margin = gatherer.width + max_item_width;
+        grid.Collect(gatherer, g,
+                     {std::min(gatherer.start_pos.x, gatherer.end_pos.x) - margin,
+                      std::min(gatherer.start_pos.y, gatherer.end_pos.y) - margin},
+                     {std::max(gatherer.start_pos.x, gatherer.end_pos.x) + margin,
+                      std::max(gatherer.start_pos.y, gatherer.end_pos.y) + margin},
+                     detected_events);
+    }
+
+    SortByTime(detected_events);
+    return detected_events;
+}
+
 }  // namespace collision_detector
\ No newline at end of file
@@ -1,62 +1,121 @@
-#pragma once
-
-#include "geom.h"
-
-#include <algorithm>
-#include <vector>
-
-namespace collision_detector {
-
-struct CollectionResult {
-    bool IsCollected(double collect_radius) const {
-        return proj_ratio >= 0 && proj_ratio <= 1 && sq_distance <= collect_radius * collect_radius;
-    }
-
-    // Квадрат расстояния до точки
-    double sq_distance;
-    // Доля пройденного отрезка
-    double proj_ratio;
-};
-
-// Движемся из точки a в точку b и пытаемся подобрать точку c
-CollectionResult TryCollectPoint(geom::Point2D a, geom::Point2D b, geom::Point2D c);
-
-struct Item {
-    geom::Point2D position;
-    double width;
-    Item(){}
-    Item(geom::Point2D position, double width) : position(position), width(width){}
-    virtual ~Item(){}
-};
-
-struct Gatherer {
-    geom::Point2D start_pos = {0., 0.};
-    geom::Point2D end_pos = {0., 0.};
-    double width = 0.;
-    Gatherer() {} 
-    Gatherer(geom::Point2D start_pos, geom::Point2D end_pos, double width) 
-    :start_pos(start_pos), end_pos(end_pos), width(width) {}
-    virtual ~Gatherer(){}
-};
-
-class ItemGathererProvider {
-protected:
-    ~ItemGathererProvider() = default;
-
-public:
-    virtual size_t ItemsCount() const = 0;
-    virtual Item GetItem(size_t idx) const = 0;
-    virtual size_t GatherersCount() const = 0;
-    virtual Gatherer GetGatherer(size_t idx) const = 0;
-};
-
-struct GatheringEvent {
-    size_t item_id;
-    size_t gatherer_id;
-    double sq_distance;
-    double time;
-};
-
-std::vector<GatheringEvent> FindGatherEvents(const ItemGathererProvider& provider);
-
+#pragma once
+
+#include "geom.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace collision_detector {
+
+struct CollectionResult {
+    bool IsCollected(double collect_radius) const {
+        return proj_ratio >= 0 && proj_ratio <= 1 && sq_distance <= collect_radius * collect_radius;
+    }
+
+    // Квадрат расстояния до точки
+    double sq_distance;
+    // Доля пройденного отрезка
+    double proj_ratio;
+};
+
+// Движемся из точки a в точку b и пытаемся подобрать точку c
+CollectionResult TryCollectPoint(geom::Point2D a, geom::Point2D b, geom::Point2D c);
+
+// Предметы в виде структуры массивов: i-й предмет - (x[i], y[i]) шириной width[i]
+struct ItemsView {
+    const double* x = nullptr;
+    const double* y = nullptr;
+    const double* width = nullptr;
+    size_t count = 0;
+};
+
+constexpr size_t COLLECT_BATCH_SIZE = 64;
+
+struct CollectionBatch {
+    double sq_distance[COLLECT_BATCH_SIZE];
+    double proj_ratio[COLLECT_BATCH_SIZE];
+};
+
+// Пакетный TryCollectPoint для не более чем COLLECT_BATCH_SIZE предметов. Заполняет
+// result и возвращает маску подобранных: бит i установлен, если
+// IsCollected(gatherer_width + items.width[i]). Если процессор поддерживает AVX2,
+// считает по 4 предмета за инструкцию, иначе по одному. Результаты в точности
+// совпадают с TryCollectPoint.
+uint64_t TryCollectPoints(geom::Point2D a, geom::Point2D b, double gatherer_width, ItemsView items,
+                          CollectionBatch& result);
+
+struct Item {
+    geom::Point2D position;
+    double width;
+    Item(){}
+    Item(geom::Point2D position, double width) : position(position), width(width){}
+    virtual ~Item(){}
+};
+
+struct Gatherer {
+    geom::Point2D start_pos = {0., 0.};
+    geom::Point2D end_pos = {0., 0.};
+    double width = 0.;
+    Gatherer() {} 
+    Gatherer(geom::Point2D start_pos, geom::Point2D end_pos, double width) 
+    :start_pos(start_pos), end_pos(end_pos), width(width) {}
+    virtual ~Gatherer(){}
+};
+
+class ItemGathererProvider {
+protected:
+    ~ItemGathererProvider() = default;
+
+public:
+    virtual size_t ItemsCount() const = 0;
+    virtual Item GetItem(size_t idx) const = 0;
+    virtual size_t GatherersCount() const = 0;
+    virtual Gatherer GetGatherer(size_t idx) const = 0;
+
+    // Все предметы одним блоком, если провайдер хранит их так. Тогда FindGatherEvents
+    // читает их отсюда, а не через GetItem.
+    virtual std::optional<ItemsView> GetItemsView() const {
+        return std::nullopt;
+    }
+};
+
+struct GatheringEvent {
+    size_t item_id;
+    size_t gatherer_id;
+    double sq_distance;
+    double time;
+};
+
+// Рабочие массивы FindGatherEvents. Если передавать один и тот же объект от тика
+// к тику, поиск перестаёт выделять память, как только массивы дорастут до размеров мира.
+struct GatherBuffers {
+    std::vector<Gatherer> gatherers;
+    // Копия предметов провайдера, который не отдаёт их одним блоком
+    std::vector<double> items_x;
+    std::vector<double> items_y;
+    std::vector<double> items_width;
+    // Сетка: (клетка, номер предмета) по клеткам, предметы в том же порядке
+    // и начало блока каждой непустой клетки
+    std::vector<std::pair<uint64_t, size_t>> cell_items;
+    std::vector<double> cell_items_x;
+    std::vector<double> cell_items_y;
+    std::vector<double> cell_items_width;
+    std::vector<std::pair<uint64_t, size_t>> cells;
+
+    std::vector<GatheringEvent> events;
+};
+
+// Находит события сбора, отсортированные по времени. Кандидатов для каждой собаки
+// отбирает равномерная сетка по предметам; результат совпадает с полным перебором.
+std::vector<GatheringEvent> FindGatherEvents(const ItemGathererProvider& provider);
+
+// То же в переиспользуемых буферах. Возвращает buffers.events.
+const std::vector<GatheringEvent>& FindGatherEvents(const ItemGathererProvider& provider, GatherBuffers& buffers);
+
+// Перебор всех пар собака-предмет. Эталон для FindGatherEvents в тестах и бенчмарках.
+std::vector<GatheringEvent> FindGatherEventsBruteForce(const ItemGathererProvider& provider);
+
 }  // namespace collision_detector
\ No newline at end of file
@@ -0,0 +1,188 @@
+#include "dog_store.h"
+
+#include <algorithm>
+
+namespace model {
+
+DogStore::~DogStore() {
+    for (size_t row = 0; row < size_; ++row) {
+        delete GetChunk(row).history[row % CHUNK_SIZE].load(std::memory_order_relaxed);
+    }
+}
+
+void DogStore::Reserve(size_t count) {
+    while (chunks_.size() * CHUNK_SIZE < size_ + count) {
+        AddChunk();
+    }
+}
+
+size_t DogStore::Add(const Motion& motion) {
+    if (size_ == chunks_.size() * CHUNK_SIZE) {
+        AddChunk();
+    }
+    const size_t row = size_++;
+    Chunk& chunk = GetChunk(row);
+    const size_t i = row % CHUNK_SIZE;
+    Store(chunk.x[i], motion.position.x);
+    Store(chunk.y[i], motion.position.y);
+    Store(chunk.speed_x[i], motion.speed.x);
+    Store(chunk.speed_y[i], motion.speed.y);
+    Store(chunk.start_x[i], motion.gather_start.x);
+    Store(chunk.start_y[i], motion.gather_start.y);
+    Store(chunk.end_x[i], motion.gather_end.x);
+    Store(chunk.end_y[i], motion.gather_end.y);
+    Store(chunk.width[i], motion.width);
+    Store(chunk.score[i], motion.score);
+    Store(chunk.epoch[i], StateEpoch::Current());
+    Store(chunk.active[i], true);
+    active_count_.fetch_add(1, std::memory_order_relaxed);
+    return row;
+}
+
+void DogStore::Release(size_t row) {
+    GetChunk(row).active[row % CHUNK_SIZE].store(false, std::memory_order_relaxed);
+    active_count_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+DogStore::Motion DogStore::Get(size_t row, uint64_t epoch) const {
+    const Chunk& chunk = GetChunk(row);
+    const size_t i = row % CHUNK_SIZE;
+    const uint64_t row_epoch = chunk.epoch[i].load(std::memory_order_acquire);
+    if (row_epoch <= epoch) {
+        const Motion motion = Read(chunk, i);
+        // Если строку начали менять во время чтения, эпоха уже другая, а прежние
+        // значения лежат в истории
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (chunk.epoch[i].load(std::memory_order_acquire) == row_epoch) {
+            return motion;
+        }
+    }
+    const Version* version = chunk.history[i].load(std::memory_order_acquire);
+    while (version->epoch > epoch) {
+        version = version->prev.get();
+    }
+    return version->motion;
+}
+
+void DogStore::Set(size_t row, const Motion& motion) {
+    SetPosition(row, motion.position);
+    SetSpeed(row, motion.speed);
+    SetGatherer(row, motion.gather_start, motion.gather_end);
+    SetWidth(row, motion.width);
+    SetScore(row, motion.score);
+}
+
+void DogStore::SetPosition(size_t row, geom::Point2D position) {
+    Chunk& chunk = GetChunk(row);
+    const size_t i = row % CHUNK_SIZE;
+    if (Load(chunk.x[i]) != position.x || Load(chunk.y[i]) != position.y) {
+        Touch(chunk, i);
+        Store(chunk.x[i], position.x);
+        Store(chunk.y[i], position.y);
+    }
+}
+
+void DogStore::SetSpeed(size_t row, geom::Vec2D speed) {
+    Chunk& chunk = GetChunk(row);
+    const size_t i = row % CHUNK_SIZE;
+    if (Load(chunk.speed_x[i]) != speed.x || Load(chunk.speed_y[i]) != speed.y) {
+        Touch(chunk, i);
+        Store(chunk.speed_x[i], speed.x);
+        Store(chunk.speed_y[i], speed.y);
+    }
+}
+
+void DogStore::SetGatherer(size_t row, geom::Point2D start, geom::Point2D end) {
+    Chunk& chunk = GetChunk(row);
+    const size_t i = row % CHUNK_SIZE;
+    if (Load(chunk.start_x[i]) != start.x || Load(chunk.start_y[i]) != start.y || Load(chunk.end_x[i]) != end.x
+        || Load(chunk.end_y[i]) != end.y) {
+        Touch(chunk, i);
+        Store(chunk.start_x[i], start.x);
+        Store(chunk.start_y[i], start.y);
+        Store(chunk.end_x[i], end.x);
+        Store(chunk.end_y[i], end.y);
+    }
+}
+
+void DogStore::SetWidth(size_t row, double width) {
+    Chunk& chunk = GetChunk(row);
+    const size_t i = row % CHUNK_SIZE;
+    if (Load(chunk.width[i]) != width) {
+        Touch(chunk, i);
+        Store(chunk.width[i], width);
+    }
+}
+
+void DogStore::SetScore(size_t row, int score) {
+    Chunk& chunk = GetChunk(row);
+    const size_t i = row % CHUNK_SIZE;
+    if (Load(chunk.score[i]) != score) {
+        Touch(chunk, i);
+        Store(chunk.score[i], score);
+    }
+}
+
+DogStore::Motion DogStore::Read(const Chunk& chunk, size_t i) {
+    Motion motion;
+    motion.position = {Load(chunk.x[i]), Load(chunk.y[i])};
+    motion.speed = {Load(chunk.speed_x[i]), Load(chunk.speed_y[i])};
+    motion.gather_start = {Load(chunk.start_x[i]), Load(chunk.start_y[i])};
+    motion.gather_end = {Load(chunk.end_x[i]), Load(chunk.end_y[i])};
+    motion.width = Load(chunk.width[i]);
+    motion.score = Load(chunk.score[i]);
+    return motion;
+}
+
+void DogStore::Touch(Chunk& chunk, size_t i) {
+    const uint64_t current = StateEpoch::Current();
+    const uint64_t row_epoch = Load(chunk.epoch[i]);
+    if (row_epoch == current) {
+        // Значения текущей эпохи не видны ни одному закреплённому снимку
+        return;
+    }
+
+    const uint64_t oldest_pinned = StateEpoch::OldestPinned();
+    Version* history = Load(chunk.history[i]);
+    if (oldest_pinned == StateEpoch::NONE || row_epoch <= oldest_pinned) {
+        // Старые значения никто не читает, а закреплённым эпохам видны текущие
+        Store(chunk.history[i], static_cast<Version*>(nullptr));
+        delete history;
+        history = nullptr;
+        if (oldest_pinned == StateEpoch::NONE) {
+            Store(chunk.epoch[i], current);
+            return;
+        }
+    } else {
+        // Версии старше первой, видимой самой старой закреплённой эпохе, больше не нужны
+        for (Version* version = history; version; version = version->prev.get()) {
+            if (version->epoch <= oldest_pinned) {
+                version->prev.reset();
+                break;
+            }
+        }
+    }
+
+    auto* version = new Version{Read(chunk, i), row_epoch, std::unique_ptr<Version>(history)};
+    chunk.history[i].store(version, std::memory_order_release);
+    chunk.epoch[i].store(current, std::memory_order_release);
+    // Новые значения пишутся после смены эпохи (см. Get(row, epoch))
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void DogStore::AddChunk() {
+    if (chunks_.size() == table_capacity_) {
+        const size_t capacity = std::max<size_t>(4, table_capacity_ * 2);
+        auto table = std::make_unique<Chunk*[]>(capacity);
+        for (size_t k = 0; k < chunks_.size(); ++k) {
+            table[k] = chunks_[k].get();
+        }
+        table_.store(table.get(), std::memory_order_release);
+        tables_.push_back(std::move(table));
+        table_capacity_ = capacity;
+    }
+    chunks_.push_back(std::make_unique<Chunk>());
+    table_.load(std::memory_order_relaxed)[chunks_.size() - 1] = chunks_.back().get();
+}
+
+}  // namespace model
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "collision_detector.h"
+#include "geom.h"
+#include "state_epoch.h"
+
+namespace model {
+
+// Часто изменяемые поля собак сессии: координаты, скорость, отрезок сбора и счёт.
+// Поля разложены по массивам, так что тик проходит их подряд, не обращаясь к
+// самим собакам. Строки не перемещаются: номер строки - постоянный адрес собаки.
+//
+// Версии ведутся построчно по эпохам (см. StateEpoch). Первое изменение строки в
+// новой эпохе, пока есть закреплённые, сохраняет прежние значения в историю
+// строки. Читатель закреплённой эпохи берёт значения из массивов, если строка с
+// тех пор не менялась, иначе - из истории.
+class DogStore {
+public:
+    struct Motion {
+        geom::Point2D position;
+        geom::Vec2D speed;
+        geom::Point2D gather_start;
+        geom::Point2D gather_end;
+        double width = 0.6;
+        int score = 0;
+    };
+
+    DogStore() = default;
+    DogStore(const DogStore&) = delete;
+    DogStore& operator=(const DogStore&) = delete;
+    ~DogStore();
+
+    // Число строк вместе с освобождёнными
+    size_t Size() const noexcept {
+        return size_;
+    }
+    size_t GetActiveCount() const noexcept {
+        return active_count_.load(std::memory_order_relaxed);
+    }
+    void Reserve(size_t count);
+
+    // Возвращает номер строки
+    size_t Add(const Motion& motion);
+    // Строка ушедшей собаки больше не двигается и ничего не собирает.
+    // Можно вызывать из любого потока.
+    void Release(size_t row);
+    bool IsActive(size_t row) const {
+        return GetChunk(row).active[row % CHUNK_SIZE].load(std::memory_order_relaxed);
+    }
+
+    // Текущие значения читает и изменяет поток, изменяющий игру, или поток тика,
+    // которому достались эти строки
+    geom::Point2D GetPosition(size_t row) const {
+        const Chunk& chunk = GetChunk(row);
+        const size_t i = row % CHUNK_SIZE;
+        return {Load(chunk.x[i]), Load(chunk.y[i])};
+    }
+    geom::Vec2D GetSpeed(size_t row) const {
+        const Chunk& chunk = GetChunk(row);
+        const size_t i = row % CHUNK_SIZE;
+        return {Load(chunk.speed_x[i]), Load(chunk.speed_y[i])};
+    }
+    geom::Point2D GetGatherEnd(size_t row) const {
+        const Chunk& chunk = GetChunk(row);
+        const size_t i = row % CHUNK_SIZE;
+        return {Load(chunk.end_x[i]), Load(chunk.end_y[i])};
+    }
+    collision_detector::Gatherer GetGatherer(size_t row) const {
+        const Chunk& chunk = GetChunk(row);
+        const size_t i = row % CHUNK_SIZE;
+        return {{Load(chunk.start_x[i]), Load(chunk.start_y[i])}, {Load(chunk.end_x[i]), Load(chunk.end_y[i])},
+                Load(chunk.width[i])};
+    }
+    int GetScore(size_t row) const {
+        return Load(GetChunk(row).score[row % CHUNK_SIZE]);
+    }
+    Motion Get(size_t row) const {
+        return Read(GetChunk(row), row % CHUNK_SIZE);
+    }
+
+    // Значения на момент закреплённой эпохи epoch; можно читать из любого потока,
+    // пока эпоха закреплена и строка существовала в ней
+    Motion Get(size_t row, uint64_t epoch) const;
+    // Эпоха последнего изменения строки
+    uint64_t GetEpoch(size_t row) const {
+        return GetChunk(row).epoch[row % CHUNK_SIZE].load(std::memory_order_relaxed);
+    }
+
+    // Сеттеры не трогают строку, если значение не меняется
+    void Set(size_t row, const Motion& motion);
+    void SetPosition(size_t row, geom::Point2D position);
+    void SetSpeed(size_t row, geom::Vec2D speed);
+    void SetGatherer(size_t row, geom::Point2D start, geom::Point2D end);
+    void SetWidth(size_t row, double width);
+    void SetScore(size_t row, int score);
+    // Отмечает строку изменённой в текущей эпохе
+    void MarkDirty(size_t row) {
+        Touch(GetChunk(row), row % CHUNK_SIZE);
+    }
+
+private:
+    static constexpr size_t CHUNK_SIZE = 256;
+
+    struct Version {
+        Motion motion;
+        uint64_t epoch;
+        // Более старые значения, пока они нужны закреплённым эпохам
+        std::unique_ptr<Version> prev;
+    };
+
+    template <typename T>
+    using Column = std::array<std::atomic<T>, CHUNK_SIZE>;
+
+    // Поля атомарны, потому что читатель закреплённой эпохи может читать строку
+    // одновременно с её изменением; такое чтение он распознаёт по эпохе строки
+    struct Chunk {
+        Column<double> x, y;
+        Column<double> speed_x, speed_y;
+        Column<double> start_x, start_y;
+        Column<double> end_x, end_y;
+        Column<double> width;
+        Column<int> score;
+        // Эпоха последнего изменения строки
+        Column<uint64_t> epoch;
+        // Прежние значения, новые первыми
+        Column<Version*> history;
+        Column<bool> active;
+    };
+
+    template <typename T>
+    static T Load(const std::atomic<T>& value) noexcept {
+        return value.load(std::memory_order_relaxed);
+    }
+    template <typename T>
+    static void Store(std::atomic<T>& value, T new_value) noexcept {
+        value.store(new_value, std::memory_order_relaxed);
+    }
+
+    Chunk& GetChunk(size_t row) const {
+        return *table_.load(std::memory_order_acquire)[row / CHUNK_SIZE];
+    }
+    static Motion Read(const Chunk& chunk, size_t i);
+    // Вызывается перед изменением строки
+    void Touch(Chunk& chunk, size_t i);
+    void AddChunk();
+
+    std::vector<std::unique_ptr<Chunk>> chunks_;
+    // Таблица указателей на блоки. Заполненную таблицу заменяет вдвое большая,
+    // а старые остаются читателям до разрушения хранилища.
+    std::atomic<Chunk**> table_ = nullptr;
+    size_t table_capacity_ = 0;
+    std::vector<std::unique_ptr<Chunk*[]>> tables_;
+    size_t size_ = 0;
+    std::atomic<size_t> active_count_ = 0;
+};
+
+}  // namespace model
@@ -1,5 +1,7 @@
 #include "model_env.h"
 
+#include <algorithm>
+#include <numeric>
 #include <stdexcept>
 
 namespace model {
@@ -58,6 +60,11 @@ Point Road::GetEnd() const noexcept {
     return end_;
 }
 
+bool Road::Contains(Point position) const noexcept {
+    return std::min(start_.x, end_.x) <= position.x && position.x <= std::max(start_.x, end_.x)
+           && std::min(start_.y, end_.y) <= position.y && position.y <= std::max(start_.y, end_.y);
+}
+
 bool Road::IsOnArea(PointDouble position) const noexcept{
     bool is_hor = false;
     bool is_ver = false;
@@ -84,67 +91,161 @@ bool Road::IsOnArea(PointDouble position) const noexcept{
     return is_hor && is_ver;
 }
 
-PointDouble Road::GetMaxPossiblePosition(PointDouble position) const noexcept {
-    PointDouble max_possible = position;
-    double width = 0.4;
-    Point start = start_;
-    Point end = end_;
-    if(IsHorizontal()) {
-        if(start_.x > end_.x) {
-            start = end_;
-            end = start_;
-        }
-        if(position.x < start.x - width) {
-            max_possible.x = start.x - width;
-        } else if(position.x > end.x+ width) {
-            max_possible.x = end.x+ width;
-        }
-        if(position.y < start.y - width) {
-            max_possible.y = start.y - width;
-        } else if(position.y > start.y + width) {
-            max_possible.y = start.y + width;
-        }
-    } else {
-        if(start_.y > end_.y) {
-            start = end_;
-            end = start_;
-        }
-        if(position.x < start.x - width) {
-            max_possible.x = start.x - width;
-        } else if(position.x > start.x + width) {
-            max_possible.x = start.x + width;
-        }
-        if(position.y < start.y - width) {
-            max_possible.y = start.y - width;
-        } else if(position.y > end.y+ width) {
-            max_possible.y = end.y+ width;
+namespace {
+
+// Дорога как отрезок [first, last] на прямой line (y для горизонтальных, x для вертикальных)
+struct LineSpan {
+    Coord line;
+    Coord first;
+    Coord last;
+};
+
+// Сливает перекрывающиеся и касающиеся отрезки одной прямой
+std::vector<LineSpan> MergeCollinear(std::vector<LineSpan> spans) {
+    std::sort(spans.begin(), spans.end(), [](const LineSpan& lhs, const LineSpan& rhs) {
+        return std::tie(lhs.line, lhs.first) < std::tie(rhs.line, rhs.first);
+    });
+    std::vector<LineSpan> merged;
+    for(const LineSpan& span : spans) {
+        if(!merged.empty() && merged.back().line == span.line && span.first <= merged.back().last) {
+            merged.back().last = std::max(merged.back().last, span.last);
+        } else {
+            merged.push_back(span);
         }
     }
-    return max_possible;
+    return merged;
 }
 
-void RoadIndexes::AddRoadIndexes(const std::vector<Road>& roads) {
-    for(size_t i=0; i<roads.size(); ++i) {
-        const Road& road = roads[i];
-        if (road.IsHorizontal()) {
-            coord_to_idx_hor_[road.GetStart().y] = i;
+}  // namespace
+
+RoadGraph::RoadGraph(const std::vector<Road>& roads) {
+    std::vector<LineSpan> horizontal;
+    std::vector<LineSpan> vertical;
+    for(const Road& road : roads) {
+        const Point start = road.GetStart();
+        const Point end = road.GetEnd();
+        if(road.IsHorizontal()) {
+            horizontal.push_back({start.y, std::min(start.x, end.x), std::max(start.x, end.x)});
         } else {
-            coord_to_idx_ver_[road.GetStart().x] = i;
+            vertical.push_back({start.x, std::min(start.y, end.y), std::max(start.y, end.y)});
         }
     }
+    horizontal = MergeCollinear(std::move(horizontal));
+    vertical = MergeCollinear(std::move(vertical));
+
+    // Сначала горизонтальные отрезки, за ними вертикальные
+    segments_.reserve(horizontal.size() + vertical.size());
+    for(const LineSpan& span : horizontal) {
+        segments_.emplace_back(Road::HORIZONTAL, Point{span.first, span.line}, span.last);
+    }
+    for(const LineSpan& span : vertical) {
+        segments_.emplace_back(Road::VERTICAL, Point{span.line, span.first}, span.last);
+    }
+
+    if(segments_.empty()) {
+        return;
+    }
+    Point min = segments_.front().GetStart();
+    Point max = segments_.front().GetEnd();
+    for(const Road& segment : segments_) {
+        min = {std::min(min.x, segment.GetStart().x), std::min(min.y, segment.GetStart().y)};
+        max = {std::max(max.x, segment.GetEnd().x), std::max(max.y, segment.GetEnd().y)};
+    }
+    origin_ = min;
+    const int64_t width = int64_t{max.x} - min.x + 1;
+    const int64_t height = int64_t{max.y} - min.y + 1;
+    const auto cells_along = [this](int64_t length) {
+        return static_cast<size_t>((length + cell_size_ - 1) / cell_size_);
+    };
+    size_t road_points = 0;
+    for(const Road& segment : segments_) {
+        road_points += segment.GetEnd().x - segment.GetStart().x + segment.GetEnd().y - segment.GetStart().y + 1;
+    }
+    while(cells_along(width) * cells_along(height) > road_points) {
+        cell_size_ *= 2;
+    }
+    columns_ = cells_along(width);
+    rows_ = cells_along(height);
+
+    // Два прохода: сначала число отрезков в каждой клетке, затем сами отрезки
+    const auto for_each_cell = [this](const Road& segment, auto&& fn) {
+        const size_t first_column = (int64_t{segment.GetStart().x} - origin_.x) / cell_size_;
+        const size_t last_column = (int64_t{segment.GetEnd().x} - origin_.x) / cell_size_;
+        const size_t first_row = (int64_t{segment.GetStart().y} - origin_.y) / cell_size_;
+        const size_t last_row = (int64_t{segment.GetEnd().y} - origin_.y) / cell_size_;
+        for(size_t row = first_row; row <= last_row; ++row) {
+            for(size_t column = first_column; column <= last_column; ++column) {
+                fn(row * columns_ + column);
+            }
+        }
+    };
+    cell_begin_.assign(columns_ * rows_ + 1, 0);
+    for(const Road& segment : segments_) {
+        for_each_cell(segment, [this](size_t cell) {
+            ++cell_begin_[cell + 1];
+        });
+    }
+    std::partial_sum(cell_begin_.begin(), cell_begin_.end(), cell_begin_.begin());
+
+    std::vector<uint32_t> cell_segment_idxs(cell_begin_.back());
+    std::vector<uint32_t> cell_end(cell_begin_.begin(), cell_begin_.end() - 1);
+    for(size_t i = 0; i < segments_.size(); ++i) {
+        for_each_cell(segments_[i], [&](size_t cell) {
+            cell_segment_idxs[cell_end[cell]++] = static_cast<uint32_t>(i);
+        });
+    }
+    cell_segments_.reserve(cell_segment_idxs.size());
+    for(uint32_t idx : cell_segment_idxs) {
+        cell_segments_.push_back(segments_[idx]);
+    }
 }
 
-std::vector<size_t> RoadIndexes::GetRoadIndexes(Point position) const {
-    std::vector<size_t> res;
-    auto it = coord_to_idx_hor_.find(position.y);
-    if(it != coord_to_idx_hor_.end()) {
-        res.push_back(it->second);
+std::span<const Road> RoadGraph::GetSegmentsAt(Point position) const {
+    if(position.x < origin_.x || position.y < origin_.y) {
+        return {};
+    }
+    const size_t column = (int64_t{position.x} - origin_.x) / cell_size_;
+    const size_t row = (int64_t{position.y} - origin_.y) / cell_size_;
+    if(column >= columns_ || row >= rows_) {
+        return {};
     }
-    auto it2 = coord_to_idx_ver_.find(position.x);
-    if(it2 != coord_to_idx_ver_.end()) {
-        res.push_back(it2->second);
+    const size_t cell = row * columns_ + column;
+    return {cell_segments_.data() + cell_begin_[cell], cell_begin_[cell + 1] - cell_begin_[cell]};
+}
+
+RoadGraph::Movement RoadGraph::Move(PointDouble position, PointDouble speed, double dt) const {
+    const bool along_x = speed.x != 0.;
+    const double velocity = along_x ? speed.x : speed.y;
+    double& coord = along_x ? position.x : position.y;
+    const double target = coord + velocity * dt;
+
+    while(true) {
+        // Дальний по ходу движения край отрезков, в области которых лежит точка
+        std::optional<double> reach;
+        const Point point = position.Round();
+        for(const Road& segment : GetSegmentsAt(point)) {
+            if(!segment.Contains(point) || !segment.IsOnArea(position)) {
+                continue;
+            }
+            const auto [min, max] = segment.GetArea();
+            const double edge = velocity > 0. ? (along_x ? max.x : max.y) : (along_x ? min.x : min.y);
+            if(!reach || (velocity > 0. ? edge > *reach : edge < *reach)) {
+                reach = edge;
+            }
+        }
+        if(!reach) {
+            return {position, true};
+        }
+        if(velocity > 0. ? target <= *reach : target >= *reach) {
+            coord = target;
+            return {position, false};
+        }
+        if(*reach == coord) {
+            return {position, true};
+        }
+        // На краю отрезка точку могут накрывать следующие отрезки
+        coord = *reach;
     }
-    return res;
 }
 
 void Map::AddOffice(Office office) {
@@ -199,35 +300,152 @@ void Map::SetDogSpeed(double dog_speed) {
 double Map::GetDogSpeed() const {return dog_speed_;}
 
 void Map::AddRoadIndexes() {
-    coords_to_road_idx_.AddRoadIndexes(roads_);
+    road_graph_ = RoadGraph(roads_);
+}
+
+Dog::Dog(const Dog& other)
+    : id_(other.id_)
+    , player_id_(other.player_id_)
+    , head_(new Version{other.GetDetails(), StateEpoch::Current(), nullptr})
+    , motion_(other.GetMotion()) {
+}
+
+Dog& Dog::operator=(const Dog& other) {
+    if (this != &other) {
+        id_ = other.id_;
+        player_id_ = other.player_id_;
+        MutableDetails() = other.GetDetails();
+        if (store_) {
+            store_->Set(row_, other.GetMotion());
+        } else {
+            motion_ = other.GetMotion();
+        }
+    }
+    return *this;
 }
 
-std::vector<size_t> Map::GetRoadIndexes(Point position) const {
-    return coords_to_road_idx_.GetRoadIndexes(position);
+Dog::~Dog() {
+    delete head_.load(std::memory_order_relaxed);
+    if (store_) {
+        store_->Release(row_);
+    }
 }
 
-std::vector<Road> Map::GetRoadsByPosition(Point position) const {
-    std::vector<Road> res;
-    std::vector<size_t> roads_idxs = GetRoadIndexes(position);
-    for(size_t idx : roads_idxs) {
-        res.push_back(roads_[idx]);
+void Dog::SetPosition(PointDouble position) {
+    if (store_) {
+        store_->SetPosition(row_, {position.x, position.y});
+    } else {
+        motion_.position = {position.x, position.y};
+    }
+}
+
+void Dog::SetSpeed(PointDouble speed) {
+    if (store_) {
+        store_->SetSpeed(row_, {speed.x, speed.y});
+    } else {
+        motion_.speed = {speed.x, speed.y};
+    }
+}
+
+void Dog::SetGatherer(geom::Point2D curr_pos, geom::Point2D next_pos) {
+    if (store_) {
+        store_->SetGatherer(row_, curr_pos, next_pos);
+    } else {
+        motion_.gather_start = curr_pos;
+        motion_.gather_end = next_pos;
+    }
+}
+
+void Dog::SetWidth(double width) {
+    if (store_) {
+        store_->SetWidth(row_, width);
+    } else {
+        motion_.width = width;
+    }
+}
+
+void Dog::SetScore(int value) {
+    if (store_) {
+        store_->SetScore(row_, value);
+    } else {
+        motion_.score = value;
     }
-    return res;
+}
+
+void Dog::AttachTo(std::shared_ptr<DogStore> store) {
+    const size_t row = store->Add(GetMotion());
+    if (store_) {
+        store_->Release(row_);
+    }
+    store_ = std::move(store);
+    row_ = row;
+}
+
+DogState Dog::GetState() const {
+    return MakeState(GetMotion(), GetDetails());
+}
+
+DogState Dog::GetState(uint64_t epoch) const {
+    const Version* version = head_.load(std::memory_order_acquire);
+    while (version->epoch > epoch) {
+        version = version->prev.get();
+    }
+    return MakeState(store_ ? store_->Get(row_, epoch) : motion_, version->details);
+}
+
+DogState Dog::MakeState(const DogStore::Motion& motion, const Details& details) {
+    DogState state;
+    state.position = {motion.position.x, motion.position.y};
+    state.speed = {motion.speed.x, motion.speed.y};
+    state.direction = details.direction;
+    state.speed_value = details.speed_value;
+    state.bag = details.bag;
+    state.score = motion.score;
+    state.gatherer = {motion.gather_start, motion.gather_end, motion.width};
+    return state;
+}
+
+Dog::Details& Dog::MutableDetails() {
+    Version* head = head_.load(std::memory_order_relaxed);
+    const uint64_t current = StateEpoch::Current();
+    if (head->epoch == current) {
+        // Версия текущей эпохи не видна ни одному закреплённому снимку
+        return head->details;
+    }
+
+    const uint64_t oldest_pinned = StateEpoch::OldestPinned();
+    if (oldest_pinned == StateEpoch::NONE) {
+        // Старые версии никто не читает
+        head->prev.reset();
+        head->epoch = current;
+        return head->details;
+    }
+
+    // Версии старше первой, видимой самой старой закреплённой эпохе, больше не нужны
+    for (Version* version = head; version; version = version->prev.get()) {
+        if (version->epoch <= oldest_pinned) {
+            version->prev.reset();
+            break;
+        }
+    }
+    auto* version = new Version{head->details, current, std::unique_ptr<Version>(head)};
+    head_.store(version, std::memory_order_release);
+    return version->details;
 }
 
 void Dog::SetDirection(const std::string& direction_str) {
     if(direction_str == "U"){
-        direction_ = Direction::NORTH;
-        SetSpeed({0., -speed_value_});
+        SetDirection(Direction::NORTH);
+        SetSpeed({0., -GetSpeedValue()});
     } else if(direction_str == "D"){
-        direction_ = Direction::SOUTH;
-        SetSpeed({0., speed_value_});
+        SetDirection(Direction::SOUTH);
+        SetSpeed({0., GetSpeedValue()});
     } else if(direction_str == "R"){
-        direction_ = Direction::WEST;
-        SetSpeed({speed_value_, 0.});
+        SetDirection(Direction::WEST);
+        SetSpeed({GetSpeedValue(), 0.});
     } else if(direction_str == "L"){
-        direction_ = Direction::EAST;
-        SetSpeed({-speed_value_, 0.});
+        SetDirection(Direction::EAST);
+        SetSpeed({-GetSpeedValue(), 0.});
     } else if(direction_str == ""){
         SetSpeed({0., 0.});
     } else {
@@ -236,7 +454,7 @@ void Dog::SetDirection(const std::string& direction_str) {
 }
 
 std::string Dog::GetDirection() const {
-    switch(direction_){
+    switch(GetDetails().direction){
         case Direction::NORTH: return "U";
         case Direction::SOUTH: return "D";
         case Direction::WEST: return "R";
@@ -244,8 +462,12 @@ std::string Dog::GetDirection() const {
     }
     return "U";
 }
-void Dog::SetSpeedValue(double speed_value) {speed_value_ = speed_value;}
-void Dog::ApplyMapSettings(std::shared_ptr<model::Map> map, bool is_rand_spawn) {
+void Dog::SetSpeedValue(double speed_value) {
+    if(speed_value != GetDetails().speed_value) {
+        MutableDetails().speed_value = speed_value;
+    }
+}
+void Dog::ApplyMapSettings(std::shared_ptr<const model::Map> map, bool is_rand_spawn) {
     if(is_rand_spawn) {
         SetPosition(map->GetRandPosition());
     } else {
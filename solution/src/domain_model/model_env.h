@@ -9,13 +9,18 @@
 
 #include <random>
 
+#include <atomic>
 #include <memory>
 #include <cmath>
+#include <cstdint>
 
 #include <optional>
+#include <span>
 
 #include <boost/json.hpp>
 #include "collision_detector.h"
+#include "dog_store.h"
+#include "state_epoch.h"
 
 
 namespace model_constants{
@@ -91,8 +96,9 @@ public:
     Point GetStart() const noexcept;
     Point GetEnd() const noexcept;
 
+    // Точка решётки лежит на осевой линии дороги
+    bool Contains(Point position) const noexcept;
     bool IsOnArea(PointDouble position) const noexcept;
-    PointDouble GetMaxPossiblePosition(PointDouble position) const noexcept;
     std::pair<PointDouble, PointDouble> GetArea() const noexcept {
         double width = 0.4;
         PointDouble min;
@@ -178,15 +184,52 @@ private:
 };
 
 
-class RoadIndexes {
+// Дорожная сеть карты, собранная при загрузке. Дороги на одной прямой, которые
+// перекрываются или касаются, сливаются в один отрезок. Для каждой клетки рамки
+// дорог таблица хранит подряд отрезки, проходящие через клетку, поэтому поиск
+// дорог в точке - одно обращение к массиву без выделения памяти. Клеток не больше,
+// чем точек решётки на дорогах: чем реже дороги, тем крупнее клетка, и таблица
+// остаётся в кэше, даже когда карт много.
+class RoadGraph {
 public:
-    RoadIndexes() {}
-    void AddRoadIndexes(const std::vector<Road>& roads);
-    std::vector<size_t> GetRoadIndexes(Point position) const;
+    RoadGraph() = default;
+    explicit RoadGraph(const std::vector<Road>& roads);
+
+    // Отрезки идут слева направо и сверху вниз: start не больше end
+    const std::vector<Road>& GetSegments() const noexcept {
+        return segments_;
+    }
+    // Отрезки клетки, в которую попадает точка. Среди них все отрезки, на осевой
+    // линии которых точка лежит (см. Road::Contains), и, если клетка больше одной
+    // точки решётки, отрезки, проходящие рядом.
+    std::span<const Road> GetSegmentsAt(Point position) const;
+    Coord GetCellSize() const noexcept {
+        return cell_size_;
+    }
+
+    struct Movement {
+        PointDouble position;
+        // Движение упёрлось в край дорог
+        bool stopped = false;
+    };
+    // Движение из position со скоростью speed, направленной вдоль одной из осей,
+    // за время dt. Точка идёт по прямой, пока остаётся в области какого-нибудь
+    // отрезка, и за шаг проходит до дальнего края накрывающих её отрезков, так что
+    // число шагов зависит от пересечённых отрезков, а не от dt. Вне дорог точка
+    // стоит на месте.
+    Movement Move(PointDouble position, PointDouble speed, double dt) const;
 
 private:
-    std::unordered_map<Coord, size_t> coord_to_idx_hor_;
-    std::unordered_map<Coord, size_t> coord_to_idx_ver_;
+    std::vector<Road> segments_;
+
+    // Клетки cell_size_ x cell_size_ от origin_ построчно; отрезки клетки k -
+    // cell_segments_[cell_begin_[k], cell_begin_[k + 1])
+    Point origin_{0, 0};
+    Coord cell_size_ = 1;
+    size_t columns_ = 0;
+    size_t rows_ = 0;
+    std::vector<uint32_t> cell_begin_;
+    std::vector<Road> cell_segments_;
 };
 
 struct LootType {
@@ -248,10 +291,16 @@ public:
     void SetBagCapacity(int bag_capacity = 3) {bag_capacity_ = bag_capacity;}
     double GetDogSpeed() const;
     int GetBagCapacity() const {return bag_capacity_;}
+    // Собирает дорожную сеть; вызывается, когда все дороги добавлены
     void AddRoadIndexes();
+    const RoadGraph& GetRoadGraph() const noexcept {
+        return road_graph_;
+    }
 
-    std::vector<size_t> GetRoadIndexes(Point position) const;
-    std::vector<Road> GetRoadsByPosition(Point position) const;
+    // Дороги клетки, в которую попадает точка решётки (см. RoadGraph::GetSegmentsAt)
+    std::span<const Road> GetRoadsByPosition(Point position) const {
+        return road_graph_.GetSegmentsAt(position);
+    }
 
     PointDouble GetRandomPosition() const {
         if (roads_.empty()) {
@@ -276,7 +325,7 @@ public:
         return loot_types_.size();
     }
 
-    const boost::json::array& GetLootTypesJson() {
+    const boost::json::array& GetLootTypesJson() const {
         return loot_types_json_;
     }
     const std::vector<LootType>& GetLootTypes() const {
@@ -306,7 +355,7 @@ private:
     int bag_capacity_ = 3;
 
 
-    RoadIndexes coords_to_road_idx_;
+    RoadGraph road_graph_;
 
     boost::json::array loot_types_json_;
     std::vector<LootType> loot_types_;
@@ -348,83 +397,171 @@ struct Bag {
     }
 };
 
-class Dog : public collision_detector::Gatherer {
+// Изменяемое состояние собаки
+struct DogState {
+    PointDouble position;
+    PointDouble speed;
+    Direction direction = Direction::NORTH;
+    double speed_value = 0.;
+    Bag bag;
+    int score = 0;
+    collision_detector::Gatherer gatherer{geom::Point2D{0., 0.}, geom::Point2D{0., 0.}, 0.6};
+};
+
+// Подвижные поля собаки в сессии (координаты, скорость, отрезок сбора и счёт)
+// живут в строке DogStore сессии, а собака лишь ссылается на неё. Пока собака не
+// добавлена в сессию, эти поля хранятся в ней самой без версий: закреплённые
+// снимки читают только собак сессий.
+//
+// Остальное состояние хранится версиями по эпохам (см. StateEpoch). Пока эпоха
+// не закреплена снимком, изменения пишутся на месте; после закрепления первое
+// изменение в новой эпохе копирует состояние, а старая версия остаётся снимку.
+class Dog {
 public:
-    explicit Dog(int player_id) : Gatherer(geom::Point2D{0., 0.}, geom::Point2D{0., 0.}, 0.6), id_(++id_counter_), player_id_(player_id){}
-    ~Dog() {}
+    explicit Dog(int player_id) : id_(++id_counter_), player_id_(player_id), head_(new Version{{}, StateEpoch::Current(), nullptr}) {}
+    Dog(const Dog& other);
+    Dog& operator=(const Dog& other);
+    ~Dog();
 
     int GetId() const {return id_;}
-    void SetPosition(PointDouble position) {position_ = position;}
-    void SetSpeed(PointDouble speed) {speed_ = speed;}
-    void SetDirection(Direction direction) {direction_ = direction;}
-    void SetDirection(const std::string& direction_str);
+    void SetPosition(PointDouble position);
+    void SetSpeed(PointDouble speed);
+    // Только для восстановления сохранённого состояния. Действие игрока меняет
+    // направление через GameSession::SetDogDirection.
+    void RestoreDirection(Direction direction) {
+        SetDirection(direction);
+    }
 
-    PointDouble GetPosition() const {return position_;}
-    PointDouble GetSpeed() const {return speed_;}
+    PointDouble GetPosition() const {
+        const geom::Point2D position = store_ ? store_->GetPosition(row_) : motion_.position;
+        return {position.x, position.y};
+    }
+    PointDouble GetSpeed() const {
+        const geom::Vec2D speed = store_ ? store_->GetSpeed(row_) : motion_.speed;
+        return {speed.x, speed.y};
+    }
     std::string GetDirection() const;
     void SetSpeedValue(double speed_value);
-    void ApplyMapSettings(std::shared_ptr<model::Map> map, bool is_rand_spawn);
+    void ApplyMapSettings(std::shared_ptr<const model::Map> map, bool is_rand_spawn);
     void Stop();
 
-    void SetGatherer(geom::Point2D curr_pos, geom::Point2D next_pos) {
-        start_pos = curr_pos;
-        end_pos = next_pos;
+    collision_detector::Gatherer GetGatherer() const {
+        if (store_) {
+            return store_->GetGatherer(row_);
+        }
+        return {motion_.gather_start, motion_.gather_end, motion_.width};
     }
+    void SetGatherer(geom::Point2D curr_pos, geom::Point2D next_pos);
     void SetGatherer(geom::Point2D next_pos) {
-        start_pos = end_pos;
-        end_pos = next_pos;
-    }
-    void SetWidth(double width) {
-        width = width;
+        SetGatherer(GetGatherer().end_pos, next_pos);
     }
+    void SetWidth(double width);
     void CleanBag() {
-        bag_.loot_objects.clear();
+        if (!GetDetails().bag.loot_objects.empty()) {
+            MutableDetails().bag.loot_objects.clear();
+        }
     }
+    // Неконстантный доступ к рюкзаку сразу считается изменением
     Bag& GetBag() {
-        return bag_;
+        return MutableDetails().bag;
     }
     const Bag& GetBag() const {
-        return bag_;
+        return GetDetails().bag;
+    }
+    void SetPositionEndGatherer() {
+        const geom::Point2D end_pos = GetGatherer().end_pos;
+        SetPosition({end_pos.x, end_pos.y});
     }
-    void SetPositionEndGatherer() {position_ = {end_pos.x, end_pos.y};}
     void AddScore(int value) {
-        score += value;
+        SetScore(GetScore() + value);
     }
     int GetScore() const {
-        return score;
+        return store_ ? store_->GetScore(row_) : motion_.score;
     }
-    int GetIdCounter() const{
+    void SetScore(int value);
+    static int GetIdCounter() {
         return id_counter_;
     }
-    void SetIdCounter(int id_counter) const{
+    static void SetIdCounter(int id_counter) {
         id_counter_ = id_counter;
     }
     double GetSpeedValue() const{
-        return speed_value_;
+        return GetDetails().speed_value;
     }
     void SetId(int id) {
         id_ = id;
     }
     void SetBag(const Bag& bag) {
-        bag_ = bag;
+        MutableDetails().bag = bag;
     }
 
     Direction GetDirectionEnum() const {
-        return direction_;
+        return GetDetails().direction;
+    }
+
+    // Переносит подвижные поля в новую строку store. Строка прежнего хранилища
+    // освобождается.
+    void AttachTo(std::shared_ptr<DogStore> store);
+
+    // Текущее состояние. Читается только потоком, изменяющим игру.
+    DogState GetState() const;
+    // Состояние на момент закреплённой эпохи epoch; можно читать из любого потока,
+    // пока эпоха закреплена и собака существовала в ней
+    DogState GetState(uint64_t epoch) const;
+
+    // Собака изменилась после эпохи epoch (например, после последнего снимка состояния)
+    bool IsModifiedAfter(uint64_t epoch) const {
+        return head_.load(std::memory_order_relaxed)->epoch > epoch || (store_ && store_->GetEpoch(row_) > epoch);
+    }
+    // Отмечает собаку изменённой в текущей эпохе
+    void MarkDirty() {
+        MutableDetails();
+        if (store_) {
+            store_->MarkDirty(row_);
+        }
     }
 private:
+    // Направление меняет только сессия, чтобы заодно сменить версию её состояния
+    friend class GameSession;
+
+    void SetDirection(Direction direction) {
+        if (direction != GetDetails().direction) {
+            MutableDetails().direction = direction;
+        }
+    }
+    void SetDirection(const std::string& direction_str);
+
+    // Редко изменяемая часть состояния
+    struct Details {
+        Direction direction = Direction::NORTH;
+        double speed_value = 0.;
+        Bag bag;
+    };
+    struct Version {
+        Details details;
+        uint64_t epoch;
+        // Предыдущая версия, пока она нужна закреплённым эпохам
+        std::unique_ptr<Version> prev;
+    };
+
+    const Details& GetDetails() const {
+        return head_.load(std::memory_order_relaxed)->details;
+    }
+    Details& MutableDetails();
+    DogStore::Motion GetMotion() const {
+        return store_ ? store_->Get(row_) : motion_;
+    }
+    static DogState MakeState(const DogStore::Motion& motion, const Details& details);
+
     int id_;
     int player_id_;
     static int id_counter_;
 
-    PointDouble position_;
-    PointDouble speed_;
-    Direction direction_=Direction::NORTH;
-
-    double speed_value_ = 0.;
-
-    Bag bag_;
-    int score = 0;
+    std::atomic<Version*> head_;
+    // Строка подвижных полей в хранилище сессии или собственные поля
+    std::shared_ptr<DogStore> store_;
+    size_t row_ = 0;
+    DogStore::Motion motion_;
 };
 
 }  // namespace model
@@ -1,75 +1,66 @@
 #include "model_game.h"
 
+#include <algorithm>
 #include <iostream>
 
 using namespace std::literals;
 
 namespace model {
 
-std::shared_ptr<Map> GameSession::GetMap() const {
+std::shared_ptr<const Map> GameSession::GetMap() const {
     return map_;
 }
 
 void GameSession::AddDog(std::shared_ptr<Dog> dog) {
     dog->GetBag().capacity = map_->GetBagCapacity();
+    dog->AttachTo(dog_store_);
+    dog->MarkDirty();
+    // Строки добавляются по порядку, так что номер собаки совпадает с её строкой
     dogs_.emplace_back(dog);
+    dirty_ = true;
+    InvalidateState();
 }
 
-const std::vector<std::shared_ptr<Dog>> GameSession::GetDogs(){
-    std::vector<std::shared_ptr<Dog>> result;
-    result.reserve(dogs_.size());
+void GameSession::UpdateDogsPosition(double dt, TickPool* pool) {
+    const size_t rows = dog_store_->Size();
 
-    auto it = dogs_.begin();
-    while (it != dogs_.end()) {
-        if (it->expired()) {
-            it = dogs_.erase(it);
-        } else {
-            result.push_back(it->lock());
-            ++it;
-        }
+    // Собаки двигаются независимо, поэтому в большой сессии блоки строк
+    // двигаются в разных потоках. Результат не зависит от разбиения, а сбор
+    // предметов после движения разбирается в одном потоке в порядке событий.
+    if(pool && pool->GetThreads() > 1 && rows >= 2 * MOVE_CHUNK_SIZE) {
+        const size_t chunks = (rows + MOVE_CHUNK_SIZE - 1) / MOVE_CHUNK_SIZE;
+        pool->Run(chunks, [this, rows, dt](size_t chunk) {
+            MoveDogs(chunk * MOVE_CHUNK_SIZE, std::min(rows, (chunk + 1) * MOVE_CHUNK_SIZE), dt);
+        });
+    } else {
+        MoveDogs(0, rows, dt);
     }
-    return result;
+    CollectAndSendItems();
+    InvalidateState();
 }
 
-void GameSession::UpdateDogsPosition(double dt) {
-    const auto& map = GetMap();
-    for (auto dog : GetDogs()) {
-        PointDouble curr_pos = dog->GetPosition();
-        Point curr_pos_int = curr_pos.Round();
-
-        std::vector<Road> roads_at_point = map->GetRoadsByPosition(curr_pos_int);
-
-        PointDouble speed = dog->GetSpeed();
-        PointDouble next_pos = curr_pos + PointDouble{speed.x * dt, speed.y * dt};
-
-        PointDouble max_possible_pos = curr_pos;
+void GameSession::MoveDogs(size_t first, size_t last, double dt) const {
+    for(size_t row = first; row < last; ++row) {
+        if(dog_store_->IsActive(row)) {
+            MoveDog(row, dt);
+        }
+    }
+}
 
-        bool is_stop = true;
+void GameSession::MoveDog(size_t row, double dt) const {
+    DogStore& store = *dog_store_;
+    const geom::Point2D position = store.GetPosition(row);
+    const geom::Vec2D speed = store.GetSpeed(row);
+    const RoadGraph::Movement movement =
+        map_->GetRoadGraph().Move({position.x, position.y}, {speed.x, speed.y}, dt);
 
-        for(const auto& road : roads_at_point) {
-            if(road.IsOnArea(next_pos)) {
-                is_stop = false;
-                max_possible_pos = next_pos;
-                break;
-            } else {
-                PointDouble tmp_max_possible = road.GetMaxPossiblePosition(next_pos);
-                double dist = curr_pos.Distance(max_possible_pos);
-                double tmp_dist = curr_pos.Distance(tmp_max_possible);
-                if(dist < tmp_dist) {
-                    max_possible_pos = tmp_max_possible;
-                }
-            }
-        }
-        if(!is_stop) {
-            dog->SetGatherer({next_pos.x, next_pos.y});
-            dog->SetPositionEndGatherer();
-        } else {
-            dog->SetGatherer({max_possible_pos.x, max_possible_pos.y});
-            dog->SetPositionEndGatherer();
-            dog->Stop();
-        }
+    // Отрезок сбора продолжается из конца прежнего, собака встаёт в его конец
+    const geom::Point2D end_pos{movement.position.x, movement.position.y};
+    store.SetGatherer(row, store.GetGatherEnd(row), end_pos);
+    store.SetPosition(row, end_pos);
+    if(movement.stopped) {
+        store.SetSpeed(row, {0., 0.});
     }
-    CollectAndSendItems();
 }
 
-}
\ No newline at end of file
+}
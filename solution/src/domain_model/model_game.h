@@ -1,6 +1,9 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <memory>
+#include <memory_resource>
 #include <vector>
 #include <unordered_map>
 
@@ -8,6 +11,8 @@
 
 #include "loot_generator.h"
 #include "collision_detector.h"
+#include "append_log.h"
+#include "tick_pool.h"
 
 #include <unordered_map>
 
@@ -63,63 +68,146 @@ public:
     double GetWidth() const {
         return width;
     }
-    int GetIdCounter() const {
+    static int GetIdCounter() {
         return id_counter_;
     }
 
-    void SetIdCounter(int id_counter) {
+    static void SetIdCounter(int id_counter) {
         id_counter_ = id_counter;
     }
 
+    // Предмет появился после эпохи epoch (например, после последнего снимка состояния)
+    bool IsCreatedAfter(uint64_t epoch) const {
+        return epoch_ > epoch;
+    }
+
 private:
     int id_;
     int type_ = 0;
     int value_ = 0;
+    uint64_t epoch_ = StateEpoch::Current();
     static int id_counter_;
 };
 
+// Предметы и собаки сессии для поиска событий сбора. Живёт вместе с сессией:
+// офисы заносятся один раз, предметы - при появлении и подборе, а отрезки сбора
+// собак читаются из хранилища сессии, поэтому в тике провайдер не перестраивается.
+// Номер собаки - номер её строки в хранилище.
 class ItemGathererProviderImpl : public collision_detector::ItemGathererProvider {
 public:
+    enum class ItemKind {
+        OFFICE,
+        LOOT
+    };
+
+    explicit ItemGathererProviderImpl(const DogStore& dog_store)
+        : dog_store_(dog_store) {
+    }
+
     size_t ItemsCount() const override{
-        return items_.size();
+        return kinds_.size();
     }
 
     collision_detector::Item GetItem(size_t idx) const override {
-        return *items_.at(idx);
+        return {{items_x_.at(idx), items_y_.at(idx)}, items_width_.at(idx)};
     }
 
     size_t GatherersCount() const override {
-        return gatherers_.size();
+        return dog_store_.Size();
     }
 
     collision_detector::Gatherer GetGatherer(size_t idx) const override {
-        return *gatherers_.at(idx);
+        // Ушедшая собака стоит на месте и ничего не собирает
+        return dog_store_.IsActive(idx) ? dog_store_.GetGatherer(idx) : collision_detector::Gatherer{};
+    }
+
+    std::optional<collision_detector::ItemsView> GetItemsView() const override {
+        return collision_detector::ItemsView{items_x_.data(), items_y_.data(), items_width_.data(), kinds_.size()};
     }
 
-    void AddItem(const std::shared_ptr<model::LootObject>& item) {
-        items_.push_back(item);
+    void AddOffice(const Office& office) {
+        AddItem(ItemKind::OFFICE, 0, office);
     }
 
-    void AddItem(const model::Office& item) {
-        items_.push_back(std::make_shared<model::Office>(item));
+    // Предмет с тем же id заменяется
+    void AddLootObject(const LootObject& loot_object) {
+        if(auto it = loot_index_.find(loot_object.GetId()); it != loot_index_.end()) {
+            SetItemPosition(it->second, loot_object);
+            return;
+        }
+        loot_index_.emplace(loot_object.GetId(), kinds_.size());
+        AddItem(ItemKind::LOOT, loot_object.GetId(), loot_object);
     }
 
-    void AddGatherer(const std::shared_ptr<model::Dog>& gatherer) {
-        gatherers_.push_back(gatherer);
+    // На место удалённого переносится последний предмет, так что номера
+    // предметов меняются
+    void RemoveLootObject(int id) {
+        auto it = loot_index_.find(id);
+        if(it == loot_index_.end()) {
+            return;
+        }
+        const size_t idx = it->second;
+        const size_t last = kinds_.size() - 1;
+        loot_index_.erase(it);
+        if(idx != last) {
+            kinds_[idx] = kinds_[last];
+            loot_ids_[idx] = loot_ids_[last];
+            items_x_[idx] = items_x_[last];
+            items_y_[idx] = items_y_[last];
+            items_width_[idx] = items_width_[last];
+            if(kinds_[idx] == ItemKind::LOOT) {
+                loot_index_[loot_ids_[idx]] = idx;
+            }
+        }
+        kinds_.pop_back();
+        loot_ids_.pop_back();
+        items_x_.pop_back();
+        items_y_.pop_back();
+        items_width_.pop_back();
     }
 
-    std::shared_ptr<model::Dog> GetDog(int idx) const {
-        return std::dynamic_pointer_cast<model::Dog>(gatherers_.at(idx));
+    void Reserve(size_t loot_objects_count) {
+        const size_t count = kinds_.size() + loot_objects_count;
+        kinds_.reserve(count);
+        loot_ids_.reserve(count);
+        items_x_.reserve(count);
+        items_y_.reserve(count);
+        items_width_.reserve(count);
+        loot_index_.reserve(loot_index_.size() + loot_objects_count);
     }
-    std::shared_ptr<model::Office> GetOffice(int idx) const {
-        return std::dynamic_pointer_cast<model::Office>(items_.at(idx));
+
+    ItemKind GetItemKind(size_t idx) const {
+        return kinds_.at(idx);
     }
-    std::shared_ptr<model::LootObject> GetLootObject(int idx) const {
-        return std::dynamic_pointer_cast<model::LootObject>(items_.at(idx));
+    // Только для ItemKind::LOOT
+    int GetLootObjectId(size_t idx) const {
+        return loot_ids_.at(idx);
     }
+
 private:
-    std::vector<std::shared_ptr<collision_detector::Item>> items_;
-    std::vector<std::shared_ptr<collision_detector::Gatherer>> gatherers_;
+    void AddItem(ItemKind kind, int loot_id, const collision_detector::Item& item) {
+        kinds_.push_back(kind);
+        loot_ids_.push_back(loot_id);
+        items_x_.push_back(item.position.x);
+        items_y_.push_back(item.position.y);
+        items_width_.push_back(item.width);
+    }
+    void SetItemPosition(size_t idx, const collision_detector::Item& item) {
+        items_x_[idx] = item.position.x;
+        items_y_[idx] = item.position.y;
+        items_width_[idx] = item.width;
+    }
+
+    const DogStore& dog_store_;
+    // Предметы по номеру: вид, id предмета и координаты с шириной подряд,
+    // для пакетной проверки сбора
+    std::vector<ItemKind> kinds_;
+    std::vector<int> loot_ids_;
+    std::vector<double> items_x_;
+    std::vector<double> items_y_;
+    std::vector<double> items_width_;
+    // id предмета -> номер
+    std::unordered_map<int, size_t> loot_index_;
 };
 
 class GameSession {
@@ -127,12 +215,25 @@ class GameSession {
     GameSession& operator=(const GameSession&) = delete;
 
 public:
-    explicit GameSession(std::shared_ptr<Map> map) : map_(map) {}
+    using LootLog = AppendLog<std::shared_ptr<LootObject>>;
+
+    static constexpr size_t MOVE_CHUNK_SIZE = 256;
+
+    explicit GameSession(std::shared_ptr<const Map> map) : map_(map), gather_provider_(*dog_store_) {
+        for(const Office& office : map_->GetOffices()) {
+            gather_provider_.AddOffice(office);
+        }
+    }
 
-    std::shared_ptr<Map> GetMap() const;
+    std::shared_ptr<const Map> GetMap() const;
+    // Подвижные поля собаки переезжают в хранилище сессии
     void AddDog(std::shared_ptr<Dog> dog);
-    const std::vector<std::shared_ptr<Dog>> GetDogs();
-    void UpdateDogsPosition(double dt);
+    size_t GetDogsCount() const {
+        return dog_store_->GetActiveCount();
+    }
+    // Двигает собак и разбирает сбор предметов. Если передан pool, большая
+    // сессия двигает собак блоками по MOVE_CHUNK_SIZE в его потоках.
+    void UpdateDogsPosition(double dt, TickPool* pool = nullptr);
 
     const std::unordered_map<int, std::shared_ptr<LootObject>>& GetLootObjects() const{
         return loot_objects_;
@@ -141,68 +242,114 @@ public:
         return loot_objects_.size();
     }
 
-    void GenerateLootObjects(int number) {
+    // Возвращает появившиеся предметы, чтобы их можно было записать в журнал.
+    // Список размещается в memory (обычно в арене тика), сами предметы - в куче.
+    std::pmr::vector<std::shared_ptr<LootObject>> GenerateLootObjects(
+        int number, std::pmr::memory_resource* memory = std::pmr::get_default_resource()) {
+        std::pmr::vector<std::shared_ptr<LootObject>> generated(memory);
+        generated.reserve(number);
         for(int i = 0; i < number; ++i) {
             std::pair<int, int> type_and_value = map_->GetRandomTypeAndValueOfLoot();
             PointDouble pos = map_->GetRandomPosition();
             LootObject loot_object(type_and_value.first, type_and_value.second, geom::Point2D(pos.x, pos.y));
-            loot_objects_[loot_object.GetId()] = std::make_shared<LootObject>(loot_object);
+            auto loot_object_ptr = std::make_shared<LootObject>(loot_object);
+            PutLootObject(loot_object_ptr);
+            generated.push_back(std::move(loot_object_ptr));
+            dirty_ = true;
         }
+        return generated;
     }
 
     void SetLootObjects(std::vector<LootObject>& loot_objects) {
         for(auto loot_object : loot_objects) {
-            loot_objects_[loot_object.GetId()] = std::make_shared<LootObject>(loot_object);
+            PutLootObject(std::make_shared<LootObject>(loot_object));
         }
+        dirty_ = true;
     }
     void AddLootObject(LootObject& loot_object) {
-        loot_objects_[loot_object.GetId()] = std::make_shared<LootObject>(loot_object);
-    }
-
-    ItemGathererProviderImpl CreateProvider() {
-        ItemGathererProviderImpl provider;
-        for(const auto& id_to_item : loot_objects_) {
-            provider.AddItem(id_to_item.second);
-        }
-        const std::vector<Office>& offices = map_->GetOffices();
-        for(const auto& office : offices) {
-            provider.AddItem(office);
+        PutLootObject(std::make_shared<LootObject>(loot_object));
+        dirty_ = true;
+    }
+    // Резервирует место перед восстановлением большой сессии
+    void Reserve(size_t dogs_count, size_t loot_objects_count) {
+        dogs_.reserve(dogs_.size() + dogs_count);
+        dog_store_->Reserve(dogs_count);
+        loot_objects_.reserve(loot_objects_.size() + loot_objects_count);
+        loot_log_index_.reserve(loot_log_index_.size() + loot_objects_count);
+        gather_provider_.Reserve(loot_objects_count);
+        if(loot_log_->GetCapacity() < loot_log_->Size() + loot_objects_count) {
+            CompactLootLog(loot_log_->Size() - loot_log_->GetRemovedCount() + loot_objects_count);
         }
-        const std::vector<std::shared_ptr<Dog>> dogs = GetDogs();
-        for(const auto& dog : dogs) {
-            provider.AddGatherer(dog);
+    }
+    void RemoveLootObject(int id) {
+        if(EraseLootObject(id)) {
+            gather_provider_.RemoveLootObject(id);
         }
-        return provider;
     }
+
+    // Предметы сессии в порядке появления вместе с удалёнными. Закреплённый
+    // снимок хранит этот список и читает его в другом потоке.
+    std::shared_ptr<const LootLog> GetLootLog() const {
+        return loot_log_;
+    }
+
+    // Сессия изменила состав собак или предметов с момента последнего снимка.
+    // Изменения самих собак отслеживаются эпохами их версий (Dog::IsModifiedAfter).
+    bool IsDirty() const {
+        return dirty_;
+    }
+    const std::vector<int>& GetRemovedLootIds() const {
+        return removed_loot_ids_;
+    }
+    void ClearDirty() {
+        dirty_ = false;
+        removed_loot_ids_.clear();
+    }
+
+    // Версия состояния, которое видят игроки сессии (/api/v1/game/state). Растёт
+    // при тике, входе в игру, смене направления собаки и появлении или подборе предметов.
+    uint64_t GetStateVersion() const noexcept {
+        return state_version_.load(std::memory_order_acquire);
+    }
+
+    // Действие игрока: направление собаки этой сессии ("U", "D", "L", "R" или "")
+    void SetDogDirection(Dog& dog, const std::string& direction) {
+        dog.SetDirection(direction);
+        InvalidateState();
+    }
+
     void CollectAndSendItems() {
-        ItemGathererProviderImpl provider = CreateProvider();
-        auto events = collision_detector::FindGatherEvents(provider);
-        
+        const auto& events = collision_detector::FindGatherEvents(gather_provider_, gather_buffers_);
+
+        // Из провайдера подобранные предметы убираются после разбора всех событий,
+        // чтобы не сдвинуть номера предметов в ещё не разобранных
+        picked_loot_ids_.clear();
         for(const auto& event : events) {
-            int item_idx = event.item_id;
-            std::shared_ptr<Dog> dog = provider.GetDog(event.gatherer_id);
+            const size_t item_idx = event.item_id;
+            std::shared_ptr<Dog> dog = dogs_[event.gatherer_id].lock();
+            if(!dog) {
+                continue;
+            }
 
-            std::shared_ptr<Office> office = provider.GetOffice(item_idx);
-            if(office) {
+            if(gather_provider_.GetItemKind(item_idx) == ItemGathererProviderImpl::ItemKind::OFFICE) {
                 dog->CleanBag();
                 continue;
             }
-            std::shared_ptr<LootObject> loot_object = provider.GetLootObject(item_idx);
-            if(loot_object) {
-                auto it_item = loot_objects_.find(loot_object->GetId());
-                if(it_item != loot_objects_.end()) {
-                    Bag& bag = dog->GetBag();
-                    if(!bag.IsFull()) {
-                        bag.AddLoot(it_item->second);
-                        dog->AddScore(loot_object->GetValue());
-                        loot_objects_.erase(it_item);
-                    }
+            const int loot_id = gather_provider_.GetLootObjectId(item_idx);
+            auto it_item = loot_objects_.find(loot_id);
+            if(it_item != loot_objects_.end()) {
+                Bag& bag = dog->GetBag();
+                if(!bag.IsFull()) {
+                    bag.AddLoot(it_item->second);
+                    dog->AddScore(it_item->second->GetValue());
+                    EraseLootObject(loot_id);
+                    picked_loot_ids_.push_back(loot_id);
                 }
             }
-            
-
         }
-        
+        for(int loot_id : picked_loot_ids_) {
+            gather_provider_.RemoveLootObject(loot_id);
+        }
     }
 
     const std::vector<std::shared_ptr<Dog>> GetDogs() const {
@@ -218,9 +365,67 @@ public:
 
 
 private:
-    std::shared_ptr<Map> map_;
+    std::shared_ptr<const Map> map_;
+    // Собаки по номерам их строк в dog_store_
     std::vector<std::weak_ptr<Dog>> dogs_;
+    std::shared_ptr<DogStore> dog_store_ = std::make_shared<DogStore>();
+    ItemGathererProviderImpl gather_provider_;
+    // Переиспользуются от тика к тику, чтобы сбор предметов не выделял память
+    collision_detector::GatherBuffers gather_buffers_;
+    std::vector<int> picked_loot_ids_;
     std::unordered_map<int, std::shared_ptr<LootObject>> loot_objects_;
+    std::shared_ptr<LootLog> loot_log_ = std::make_shared<LootLog>();
+    // id предмета -> индекс в loot_log_
+    std::unordered_map<int, size_t> loot_log_index_;
+    std::vector<int> removed_loot_ids_;
+    bool dirty_ = true;
+    std::atomic<uint64_t> state_version_ = 0;
+
+    void InvalidateState() noexcept {
+        state_version_.fetch_add(1, std::memory_order_release);
+    }
+
+    void PutLootObject(std::shared_ptr<LootObject> loot_object) {
+        const int id = loot_object->GetId();
+        auto [it, inserted] = loot_objects_.insert_or_assign(id, loot_object);
+        if(!inserted) {
+            loot_log_->Remove(loot_log_index_.at(id));
+        }
+        if(loot_log_->NeedsCompaction()) {
+            CompactLootLog();
+        }
+        gather_provider_.AddLootObject(*loot_object);
+        loot_log_index_[id] = loot_log_->Append(std::move(loot_object));
+        InvalidateState();
+    }
+
+    // Двигает собак строк [first, last) хранилища
+    void MoveDogs(size_t first, size_t last, double dt) const;
+    void MoveDog(size_t row, double dt) const;
+
+    // Убирает предмет из сессии, но не из провайдера сбора
+    bool EraseLootObject(int id) {
+        if(!loot_objects_.erase(id)) {
+            return false;
+        }
+        auto it = loot_log_index_.find(id);
+        loot_log_->Remove(it->second);
+        loot_log_index_.erase(it);
+        if(loot_log_->NeedsCompaction()) {
+            CompactLootLog();
+        }
+        removed_loot_ids_.push_back(id);
+        dirty_ = true;
+        InvalidateState();
+        return true;
+    }
+
+    // Старый список остаётся у закреплённых снимков, которые его читают
+    void CompactLootLog(size_t min_capacity = 0) {
+        loot_log_ = loot_log_->Compact([this](const std::shared_ptr<LootObject>& loot_object, size_t idx) {
+            loot_log_index_[loot_object->GetId()] = idx;
+        }, min_capacity);
+    }
 };
 
 }
@@ -0,0 +1,39 @@
+#include "state_epoch.h"
+
+namespace model {
+
+// Эпоха 0 старше любого изменения
+std::atomic<uint64_t> StateEpoch::current_ = 1;
+std::atomic<uint64_t> StateEpoch::oldest_pinned_ = StateEpoch::NONE;
+std::mutex StateEpoch::mutex_;
+std::map<uint64_t, unsigned> StateEpoch::pinned_;
+
+EpochPin::EpochPin() {
+    std::lock_guard lock(StateEpoch::mutex_);
+    epoch_ = StateEpoch::Advance();
+    ++StateEpoch::pinned_[epoch_];
+    StateEpoch::oldest_pinned_.store(StateEpoch::pinned_.begin()->first, std::memory_order_release);
+}
+
+EpochPin::EpochPin(EpochPin&& other) noexcept
+    : epoch_(other.epoch_)
+    , active_(other.active_) {
+    other.active_ = false;
+}
+
+EpochPin::~EpochPin() {
+    if (!active_) {
+        return;
+    }
+    std::lock_guard lock(StateEpoch::mutex_);
+    auto it = StateEpoch::pinned_.find(epoch_);
+    if (--it->second == 0) {
+        StateEpoch::pinned_.erase(it);
+    }
+    // release: чтения закреплённых версий завершились раньше, чем поток игры
+    // увидит, что их можно изменять или удалять
+    StateEpoch::oldest_pinned_.store(StateEpoch::pinned_.empty() ? StateEpoch::NONE : StateEpoch::pinned_.begin()->first,
+                                     std::memory_order_release);
+}
+
+}  // namespace model
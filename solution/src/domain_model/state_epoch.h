@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <mutex>
+
+namespace model {
+
+// Эпохи изменяемого состояния игры. Объекты помечают свои версии эпохой, в
+// которой их меняли. Снимок закрепляет текущую эпоху за O(1): версии
+// закреплённой эпохи больше не изменяются, новые изменения пишутся в копии,
+// и закреплённое состояние можно читать из другого потока, не останавливая игру.
+class StateEpoch {
+public:
+    static constexpr uint64_t NONE = std::numeric_limits<uint64_t>::max();
+
+    // Эпоха, в которой сейчас пишутся изменения
+    static uint64_t Current() noexcept {
+        return current_.load(std::memory_order_relaxed);
+    }
+    // Завершает текущую эпоху и возвращает её номер.
+    // Вызывается из потока, изменяющего игру.
+    static uint64_t Advance() noexcept {
+        return current_.fetch_add(1, std::memory_order_relaxed);
+    }
+    // Самая старая закреплённая эпоха или NONE, если закреплённых нет
+    static uint64_t OldestPinned() noexcept {
+        return oldest_pinned_.load(std::memory_order_acquire);
+    }
+
+private:
+    friend class EpochPin;
+
+    static std::atomic<uint64_t> current_;
+    static std::atomic<uint64_t> oldest_pinned_;
+    static std::mutex mutex_;
+    // Закреплённая эпоха -> число закреплений
+    static std::map<uint64_t, unsigned> pinned_;
+};
+
+// Пока объект жив, версии состояния закреплённой эпохи не изменяются и не удаляются.
+// Создаётся потоком, изменяющим игру, разрушаться может в любом потоке.
+class EpochPin {
+public:
+    // Завершает текущую эпоху и закрепляет её
+    EpochPin();
+
+    EpochPin(EpochPin&& other) noexcept;
+    EpochPin(const EpochPin&) = delete;
+    EpochPin& operator=(const EpochPin&) = delete;
+    EpochPin& operator=(EpochPin&&) = delete;
+
+    ~EpochPin();
+
+    uint64_t GetEpoch() const noexcept {
+        return epoch_;
+    }
+
+private:
+    uint64_t epoch_;
+    bool active_ = true;
+};
+
+}  // namespace model
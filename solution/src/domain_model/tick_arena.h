@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+
+namespace model {
+
+// Память для данных, которые живут не дольше одного тика. Выделение - сдвиг
+// указателя в буфере, а освобождается всё сразу в Reset в конце тика. Чего не
+// хватило в буфере, берётся из кучи; тогда при сбросе буфер вырастает так,
+// чтобы следующий такой же тик в него поместился.
+//
+// Арена не потокобезопасна: ею пользуется только поток, выполняющий тик, а не
+// потоки TickPool.
+class TickArena {
+public:
+    static constexpr size_t DEFAULT_SIZE = 64 * 1024;
+
+    explicit TickArena(size_t size = DEFAULT_SIZE)
+        : size_(size)
+        , buffer_(std::make_unique<std::byte[]>(size_)) {
+        resource_.emplace(buffer_.get(), size_, &overflow_);
+    }
+
+    TickArena(const TickArena&) = delete;
+    TickArena& operator=(const TickArena&) = delete;
+
+    std::pmr::memory_resource* GetResource() noexcept {
+        return &*resource_;
+    }
+    size_t GetSize() const noexcept {
+        return size_;
+    }
+
+    // Все объекты, размещённые в арене, к этому моменту должны быть разрушены
+    void Reset() {
+        resource_->release();
+        const size_t overflow = overflow_.TakeAllocated();
+        if(overflow > 0) {
+            resource_.reset();
+            size_ += overflow;
+            buffer_ = std::make_unique<std::byte[]>(size_);
+            resource_.emplace(buffer_.get(), size_, &overflow_);
+        }
+    }
+
+private:
+    // Куча, которая считает, сколько взято сверх буфера
+    class OverflowResource : public std::pmr::memory_resource {
+    public:
+        size_t TakeAllocated() noexcept {
+            const size_t allocated = allocated_;
+            allocated_ = 0;
+            return allocated;
+        }
+
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override {
+            void* ptr = std::pmr::new_delete_resource()->allocate(bytes, alignment);
+            allocated_ += bytes;
+            return ptr;
+        }
+        void do_deallocate(void* ptr, size_t bytes, size_t alignment) override {
+            std::pmr::new_delete_resource()->deallocate(ptr, bytes, alignment);
+        }
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+
+        size_t allocated_ = 0;
+    };
+
+    size_t size_;
+    std::unique_ptr<std::byte[]> buffer_;
+    OverflowResource overflow_;
+    std::optional<std::pmr::monotonic_buffer_resource> resource_;
+};
+
+}  // namespace model
@@ -0,0 +1,92 @@
+#include "tick_pool.h"
+
+#include <boost/asio/post.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace model {
+
+// Помощник из пула, начавший работу после того, как вызывающий поток закрыл
+// задание, сразу выходит. Поэтому Run ждёт только начавших помощников и не
+// зависает, даже если все потоки пула заняты задачами внешнего Run.
+struct TickPool::Job {
+    Job(const std::function<void(size_t)>& fn, size_t count)
+        : fn(fn)
+        , count(count) {
+    }
+
+    const std::function<void(size_t)>& fn;
+    const size_t count;
+    std::atomic<size_t> next = 0;
+
+    std::mutex mutex;
+    std::condition_variable idle;
+    size_t active = 0;
+    bool closed = false;
+    std::exception_ptr error;
+
+    void Work() {
+        for(size_t i = next++; i < count; i = next++) {
+            try {
+                fn(i);
+            } catch(...) {
+                std::lock_guard lock(mutex);
+                if(!error) {
+                    error = std::current_exception();
+                }
+            }
+        }
+    }
+
+    void Help() {
+        {
+            std::lock_guard lock(mutex);
+            if(closed) {
+                return;
+            }
+            ++active;
+        }
+        Work();
+        std::lock_guard lock(mutex);
+        if(--active == 0) {
+            idle.notify_one();
+        }
+    }
+};
+
+TickPool::TickPool(unsigned threads)
+    : threads_(threads == 0 ? std::max(1u, std::thread::hardware_concurrency()) : threads) {
+    if(threads_ > 1) {
+        pool_.emplace(threads_ - 1);
+    }
+}
+
+void TickPool::Run(size_t count, const std::function<void(size_t)>& fn) {
+    auto job = std::make_shared<Job>(fn, count);
+
+    // Лишние потоки не будятся, если задач меньше, чем потоков
+    const size_t helpers = pool_ ? std::min<size_t>(threads_ - 1, count > 0 ? count - 1 : 0) : 0;
+    for(size_t i = 0; i < helpers; ++i) {
+        boost::asio::post(*pool_, [job] {
+            job->Help();
+        });
+    }
+    job->Work();
+
+    std::unique_lock lock(job->mutex);
+    job->closed = true;
+    job->idle.wait(lock, [&job] {
+        return job->active == 0;
+    });
+    if(job->error) {
+        std::rethrow_exception(job->error);
+    }
+}
+
+}  // namespace model
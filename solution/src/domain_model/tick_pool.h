@@ -0,0 +1,41 @@
+#pragma once
+
+#include <boost/asio/thread_pool.hpp>
+
+#include <cstddef>
+#include <functional>
+#include <optional>
+
+namespace model {
+
+// Потоки, которые выполняют независимые задачи параллельно: в тике - сессии
+// разных карт и блоки собак внутри сессии, при сохранении - блоки сессий
+// полного снимка. Номера задач раздаются из общего счётчика, поэтому поток,
+// закончивший маленькую задачу, сразу берёт следующую, а не ждёт крупную.
+// Вызывающий поток тоже выполняет задачи, а Run можно вызывать из задачи
+// другого Run.
+class TickPool {
+public:
+    // threads - сколько потоков вместе с вызывающим выполняют задачи (0 - по числу ядер)
+    explicit TickPool(unsigned threads);
+
+    TickPool(const TickPool&) = delete;
+    TickPool& operator=(const TickPool&) = delete;
+
+    unsigned GetThreads() const noexcept {
+        return threads_;
+    }
+
+    // Выполняет fn(0) ... fn(count - 1) и возвращается, когда все задачи завершены.
+    // Первое из брошенных исключений пробрасывается после завершения остальных.
+    void Run(size_t count, const std::function<void(size_t)>& fn);
+
+private:
+    struct Job;
+
+    unsigned threads_;
+    // Нет, если поток один
+    std::optional<boost::asio::thread_pool> pool_;
+};
+
+}  // namespace model
@@ -56,6 +56,21 @@ ApiObject DetermineApiObject(const std::string& target_str) {
     return ApiObject::UNKNOWN;
 }
 
+ApiExecution GetApiExecution(ApiObject api_object) {
+    switch (api_object) {
+        case ApiObject::MAPS:
+        case ApiObject::MAPBYID:
+            return ApiExecution::IMMUTABLE;
+        case ApiObject::PLAYERS:
+        case ApiObject::STATE:
+            return ApiExecution::PUBLISHED;
+        default:
+            // Вход, действие и тик меняют игру, а ответы об ошибках неизвестного
+            // запроса дёшевы, так что всё остальное идёт в strand игры
+            return ApiExecution::GAME_STRAND;
+    }
+}
+
 boost::json::array ApiRequestHandler::CreateRoadsJson(const model::Map& map) {
     boost::json::array json_roads;
     for (const auto& road : map.GetRoads()) {
@@ -134,34 +149,36 @@ std::string ApiRequestHandler::GetMapsResponseBody() const {
 
     for(const auto& map : game_server_.GetMaps()) {
         boost::json::object json_map;
-        json_map["id"] = *(map.GetId());
-        json_map["name"] = map.GetName();
+        json_map["id"] = *(map->GetId());
+        json_map["name"] = map->GetName();
         json_maps.push_back(json_map);
     }
 
     return boost::json::serialize(json_maps);
 }
 
-std::string ApiRequestHandler::GetMapByIdResponseBody(std::string_view map_id) const {
+std::string ApiRequestHandler::GetMapByIdResponseBody(const model::Map& map) const {
     boost::json::object json_map_by_id;
+    json_map_by_id["id"] = *(map.GetId());
+    json_map_by_id["name"] = map.GetName();
+    json_map_by_id["roads"] = CreateRoadsJson(map);
+    json_map_by_id["buildings"] = CreateBuildingsJson(map);
+    json_map_by_id["offices"] = CreateOfficesJson(map);
+    json_map_by_id["lootTypes"] = CreateLootTypesJson(map);
+    return boost::json::serialize(json_map_by_id);
+}
 
-    model::Map::Id  id{std::string(map_id)};
-    std::shared_ptr<model::Map> map = game_server_.FindMap(id);
-    if (map != nullptr) {
-        json_map_by_id["id"] = *(map->GetId());
-        json_map_by_id["name"] = map->GetName();
-        json_map_by_id["roads"] = CreateRoadsJson(*map);
-        json_map_by_id["buildings"] = CreateBuildingsJson(*map);
-        json_map_by_id["offices"] = CreateOfficesJson(*map);
-        json_map_by_id["lootTypes"] = CreateLootTypesJson(*map);
-        return boost::json::serialize(json_map_by_id);
-    }
-    return "";
+void ApiRequestHandler::PrerenderMaps() {
+    maps_body_ = PrerenderedBody::Make(GetMapsResponseBody());
+    for (const auto& map : game_server_.GetMaps()) {
+        map_bodies_.emplace(map->GetId(), PrerenderedBody::Make(GetMapByIdResponseBody(*map)));
+    }
 }
 
-std::string ApiRequestHandler::GetJoinResponseBody(std::shared_ptr<model::Map> map, const std::string& user_name) const {
+std::string ApiRequestHandler::GetJoinResponseBody(std::shared_ptr<const model::Map> map, const std::string& user_name) const {
     try {
         std::pair<const std::shared_ptr<model::Player>, model::Token> player_and_token = game_server_.JoinGame(map, user_name);
+        game_server_.JournalJoin(map->GetId(), *player_and_token.first, player_and_token.second);
         boost::json::object responce_body;
         responce_body["authToken"] = *player_and_token.second;
         responce_body["playerId"] = player_and_token.first->GetId();
@@ -171,22 +188,28 @@ std::string ApiRequestHandler::GetJoinResponseBody(std::shared_ptr<model::Map> m
     }
 }
 
-std::string ApiRequestHandler::GetPlayerListResponseBody(std::shared_ptr<const model::Player> player) const {
+std::shared_ptr<const SessionBody> ApiRequestHandler::GetSessionBody(const model::Player& player, SessionBody::Kind kind) const {
+    const std::shared_ptr<model::GameSession> session = player.GetPlayersSession();
+    if (std::shared_ptr<const SessionBody> body = session_bodies_.Find(*session, kind)) {
+        return body;
+    }
+    return session_bodies_.Publish(*session, kind, kind == SessionBody::STATE ? RenderGameState(session) : RenderPlayerList(session));
+}
+
+std::string ApiRequestHandler::RenderPlayerList(const std::shared_ptr<model::GameSession>& session) const {
     boost::json::object responce_body_obj;
-    const std::shared_ptr<model::GameSession> session = player->GetPlayersSession();
-    for (auto token_and_player : game_server_.GetTokenToPlayerMap(session)) {
+    for (const auto& token_and_player : game_server_.GetTokenToPlayerMap(session)) {
         std::shared_ptr<model::Player> tmp_player = token_and_player.second;
         responce_body_obj[std::to_string(tmp_player->GetId())] = boost::json::object{{"name", tmp_player->GetName()}};
     }
     return boost::json::serialize(responce_body_obj);
 }
 
-std::string ApiRequestHandler::GetGameStateResponseBody(std::shared_ptr<const model::Player> player) const {
+std::string ApiRequestHandler::RenderGameState(const std::shared_ptr<model::GameSession>& session) const {
     boost::json::object responce_body_obj;
     boost::json::object players_json;
     boost::json::object loot_objects_json;
-    const std::shared_ptr<model::GameSession> session = player->GetPlayersSession();
-    for (auto token_and_player : game_server_.GetTokenToPlayerMap(session)) {
+    for (const auto& token_and_player : game_server_.GetTokenToPlayerMap(session)) {
         auto& tmp_player = token_and_player.second;
         
         auto dog = tmp_player->GetDog();
@@ -229,7 +252,7 @@ std::string ApiRequestHandler::GetGameStateResponseBody(std::shared_ptr<const mo
 
 void ApiRequestHandler::DoPlayerAction(std::shared_ptr<const model::Player> player, const std::string& direction) const {
     try {
-        player->GetDog()->SetDirection(direction);
+        game_server_.ApplyPlayerAction(*player, direction);
     } catch (const std::exception& ex) {
         throw;
     }
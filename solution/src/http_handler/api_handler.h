@@ -14,6 +14,8 @@
 #include "../domain_model/model_env.h"
 #include "../application_model/model_app.h"
 #include "../application_model/game_server.h"
+#include "prerendered_body.h"
+#include "session_bodies.h"
 
 namespace json = boost::json;
 namespace beast = boost::beast;
@@ -32,6 +34,16 @@ enum class ApiObject {
     UNKNOWN
 };
 
+// Где обрабатывается запрос к API (см. RequestHandler)
+enum class ApiExecution {
+    // Ответ собран заранее и не меняется (карты): в потоке соединения без блокировок
+    IMMUTABLE,
+    // Чтение сессии: из опубликованного тела, а если оно устарело - в strand игры
+    PUBLISHED,
+    // Изменение игры: в strand игры
+    GAME_STRAND
+};
+
 namespace content_type {
     inline constexpr static std::string_view HTML = "text/html"sv;
     inline constexpr static std::string_view CSS = "text/css"sv;
@@ -89,11 +101,14 @@ StringResponse MakeStringResponse(http::status status, std::string_view body, un
                                 std::string_view content_type = content_type::HTML, std::string_view cache = ""sv, std::string_view allow =""sv);
 
 ApiObject DetermineApiObject(const std::string& target_str);
+ApiExecution GetApiExecution(ApiObject api_object);
 
 class ApiRequestHandler {
         using Response = std::variant<http::response<http::string_body>, http::response<http::file_body>>;
 public:
-    explicit ApiRequestHandler(GameServer& game_server) : game_server_{game_server} {}
+    explicit ApiRequestHandler(GameServer& game_server) : game_server_{game_server}, session_bodies_{game_server.GetMaps()} {
+        PrerenderMaps();
+    }
 
     ApiRequestHandler(const ApiRequestHandler&) = delete;
     ApiRequestHandler& operator=(const ApiRequestHandler&) = delete;
@@ -130,8 +145,34 @@ public:
         return MakeStringResponse(http::status::bad_request, errors_handler::BAD_REQ, req.version(), req.keep_alive(), content_type::JSON);
     }
 
+    // Отвечает на чтение сессии вне strand игры. Возвращает nullopt, если
+    // опубликованное тело устарело и его нужно собрать в strand (HandleRequest).
+    template <typename Body, typename Allocator>
+    std::optional<http::response<http::string_body>> TryHandlePublished(const http::request<Body, http::basic_fields<Allocator>>& req,
+                                                                        const std::string& req_target) {
+        switch(DetermineApiObject(req_target)) {
+            case ApiObject::PLAYERS:
+                return HandleSessionReadRequest(req, SessionBody::PLAYERS, true);
+            case ApiObject::STATE:
+                return HandleSessionReadRequest(req, SessionBody::STATE, true);
+            default:
+                return std::nullopt;
+        }
+    }
+
 private:
     GameServer& game_server_;
+    // Ответы /api/v1/maps собираются при запуске: после загрузки карты не меняются
+    std::shared_ptr<const PrerenderedBody> maps_body_;
+    std::unordered_map<model::Map::Id, std::shared_ptr<const PrerenderedBody>, util::TaggedHasher<model::Map::Id>> map_bodies_;
+
+    // Тела /api/v1/game/state и /api/v1/game/players, собранные в strand игры
+    // по первому запросу после изменения сессии
+    SessionBodies session_bodies_;
+
+    void PrerenderMaps();
+    // Собирает и публикует тело, если опубликованное устарело; только в strand игры
+    std::shared_ptr<const SessionBody> GetSessionBody(const model::Player& player, SessionBody::Kind kind) const;
 
     static boost::json::array CreateRoadsJson(const model::Map& map);
     static boost::json::array CreateBuildingsJson(const model::Map& map);
@@ -139,10 +180,10 @@ private:
     static boost::json::array CreateLootTypesJson(const model::Map& map);
 
     std::string GetMapsResponseBody() const;
-    std::string GetMapByIdResponseBody(std::string_view map_id) const;
-    std::string GetJoinResponseBody(std::shared_ptr<model::Map> map, const std::string& user_name) const;
-    std::string GetPlayerListResponseBody(std::shared_ptr<const model::Player> player) const;
-    std::string GetGameStateResponseBody(std::shared_ptr<const model::Player> player) const;
+    std::string GetMapByIdResponseBody(const model::Map& map) const;
+    std::string GetJoinResponseBody(std::shared_ptr<const model::Map> map, const std::string& user_name) const;
+    std::string RenderPlayerList(const std::shared_ptr<model::GameSession>& session) const;
+    std::string RenderGameState(const std::shared_ptr<model::GameSession>& session) const;
     void DoPlayerAction(std::shared_ptr<const model::Player> player, const std::string& direction) const;
 
     template <typename Body, typename Allocator>
@@ -154,8 +195,7 @@ private:
         if (req.method() != http::verb::get) {
             return text_response(http::status::method_not_allowed, errors_handler::INVALID_GET, "GET"sv);
         }
-        std::string responce_body = GetMapsResponseBody();
-        return text_response(http::status::ok, responce_body);
+        return MakePrerenderedResponse(req, *maps_body_);
     }
 
     template <typename Body, typename Allocator>
@@ -171,11 +211,41 @@ private:
             return text_response(http::status::bad_request, errors_handler::BAD_REQ);
         }
 
-        std::string responce_body = GetMapByIdResponseBody(map_id);
-        if(responce_body.empty()) {
+        auto it = map_bodies_.find(model::Map::Id{map_id});
+        if(it == map_bodies_.end()) {
             return text_response(http::status::not_found, errors_handler::MAP_NOT_FOUND);
         }
-        return text_response(http::status::ok, responce_body);
+        return MakePrerenderedResponse(req, *it->second);
+    }
+
+    // Тело копируется из готового буфера, а если у клиента та же версия (If-None-Match),
+    // уходит 304 без тела
+    template <typename Body, typename Allocator>
+    http::response<http::string_body> MakePrerenderedResponse(const http::request<Body, http::basic_fields<Allocator>>& req,
+                                                              const PrerenderedBody& prerendered) {
+        auto accept_encoding = req.find(http::field::accept_encoding);
+        const PrerenderedBody::Representation& representation
+            = prerendered.Select(accept_encoding != req.end() && AcceptsGzip(accept_encoding->value()));
+        const bool is_gzip = &representation != &prerendered.identity;
+
+        http::response<http::string_body> response;
+        auto if_none_match = req.find(http::field::if_none_match);
+        if (if_none_match != req.end() && MatchesIfNoneMatch(if_none_match->value(), representation.etag)) {
+            response = http::response<http::string_body>(http::status::not_modified, req.version());
+            response.keep_alive(req.keep_alive());
+            response.set(http::field::cache_control, "no-cache"sv);
+        } else {
+            response = MakeStringResponse(http::status::ok, representation.body, req.version(), req.keep_alive(),
+                                          content_type::JSON, "no-cache"sv);
+            if (is_gzip) {
+                response.set(http::field::content_encoding, "gzip"sv);
+            }
+        }
+        response.set(http::field::etag, representation.etag);
+        if (prerendered.gzip) {
+            response.set(http::field::vary, "Accept-Encoding"sv);
+        }
+        return response;
     }
     template <typename Body, typename Allocator>
     http::response<http::string_body> HandlePlayerJoinRequest(const http::request<Body, http::basic_fields<Allocator>>& req) {
@@ -273,32 +343,39 @@ private:
 
     template <typename Body, typename Allocator>
     http::response<http::string_body> HandlePlayersListRequest(const http::request<Body, http::basic_fields<Allocator>>& req) {
-        const auto text_response = [this, &req](http::status status, std::string_view text, std::string_view allow = ""sv) {
-            return MakeStringResponse(status, text, req.version(), req.keep_alive(), content_type::JSON, "no-cache"sv, allow);
-        };
-        if (req.method() != http::verb::get && req.method() != http::verb::head) {
-            return text_response(http::status::method_not_allowed, errors_handler::INVALID_METHOD, "GET, HEAD"sv);         
-        } 
-        
-        return ExecuteAuthorized([this, &req, &text_response](std::shared_ptr<const model::Player> player) {
-                    std::string responce_body = GetPlayerListResponseBody(player);
-                    return text_response(http::status::ok, responce_body);
-                }, req);
+        return *HandleSessionReadRequest(req, SessionBody::PLAYERS, false);
     }
 
     template <typename Body, typename Allocator>
     http::response<http::string_body> HandleGameStateRequest(const http::request<Body, http::basic_fields<Allocator>>& req) {
+        return *HandleSessionReadRequest(req, SessionBody::STATE, false);
+    }
+
+    // При published_only тело не собирается, и если опубликованное устарело,
+    // возвращается nullopt
+    template <typename Body, typename Allocator>
+    std::optional<http::response<http::string_body>> HandleSessionReadRequest(const http::request<Body, http::basic_fields<Allocator>>& req,
+                                                                              SessionBody::Kind kind, bool published_only) {
         const auto text_response = [this, &req](http::status status, std::string_view text, std::string_view allow = ""sv) {
             return MakeStringResponse(status, text, req.version(), req.keep_alive(), content_type::JSON, "no-cache"sv, allow);
         };
         if (req.method() != http::verb::get && req.method() != http::verb::head) {
-            return text_response(http::status::method_not_allowed, errors_handler::INVALID_METHOD, "GET, HEAD"sv);     
-        } 
+            return text_response(http::status::method_not_allowed, errors_handler::INVALID_METHOD, "GET, HEAD"sv);
+        }
 
-        return ExecuteAuthorized([this, &req, &text_response](std::shared_ptr<const model::Player> player) {
-            std::string responce_body = GetGameStateResponseBody(player);
-            return text_response(http::status::ok, responce_body);
+        bool is_stale = false;
+        auto response = ExecuteAuthorized([this, &text_response, kind, published_only, &is_stale](std::shared_ptr<const model::Player> player) {
+            std::shared_ptr<const SessionBody> body = published_only ? session_bodies_.Find(*player->GetPlayersSession(), kind) : GetSessionBody(*player, kind);
+            if (!body) {
+                is_stale = true;
+                return http::response<http::string_body>{};
+            }
+            return text_response(http::status::ok, body->body);
         }, req);
+        if (is_stale) {
+            return std::nullopt;
+        }
+        return response;
     }
 
     template <typename Body, typename Allocator>
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace http_handler {
+
+// Тело ответа, собранное заранее и больше не меняющееся: текст, сильный ETag
+// и, если сжатие заметно уменьшает тело, gzip-вариант со своим ETag
+struct PrerenderedBody {
+    // Тела короче этого не сжимаются: заголовки gzip съедят выигрыш
+    static constexpr size_t MIN_GZIP_SIZE = 256;
+
+    struct Representation {
+        std::string body;
+        std::string etag;
+    };
+
+    Representation identity;
+    std::optional<Representation> gzip;
+
+    static std::shared_ptr<const PrerenderedBody> Make(std::string body) {
+        auto prerendered = std::make_shared<PrerenderedBody>();
+        // ETag зависит только от содержимого, поэтому не меняется между запусками
+        const std::string hash = HashHex(body);
+        if(body.size() >= MIN_GZIP_SIZE) {
+            std::string compressed = Gzip(body);
+            if(compressed.size() < body.size()) {
+                prerendered->gzip = Representation{std::move(compressed), '"' + hash + "-gzip\""};
+            }
+        }
+        prerendered->identity = Representation{std::move(body), '"' + hash + '"'};
+        return prerendered;
+    }
+
+    const Representation& Select(bool accepts_gzip) const noexcept {
+        return accepts_gzip && gzip ? *gzip : identity;
+    }
+
+private:
+    // FNV-1a
+    static std::string HashHex(std::string_view data) {
+        uint64_t hash = 14695981039346656037ull;
+        for(unsigned char c : data) {
+            hash = (hash ^ c) * 1099511628211ull;
+        }
+        static constexpr char DIGITS[] = "0123456789abcdef";
+        std::string hex(16, '0');
+        for(size_t i = 0; i < hex.size(); ++i) {
+            hex[hex.size() - 1 - i] = DIGITS[(hash >> (4 * i)) & 0xf];
+        }
+        return hex;
+    }
+
+    static std::string Gzip(std::string_view data) {
+        namespace io = boost::iostreams;
+        std::string compressed;
+        io::filtering_ostream out;
+        out.push(io::gzip_compressor(io::gzip_params(io::gzip::best_compression)));
+        out.push(io::back_inserter(compressed));
+        out.write(data.data(), static_cast<std::streamsize>(data.size()));
+        out.reset();
+        return compressed;
+    }
+};
+
+namespace detail {
+
+// Вызывает fn для каждого элемента списка через запятую, без пробелов по краям
+template <typename Fn>
+void ForEachListItem(std::string_view list, Fn&& fn) {
+    while(!list.empty()) {
+        const size_t comma = list.find(',');
+        std::string_view item = list.substr(0, comma);
+        list = comma == std::string_view::npos ? std::string_view{} : list.substr(comma + 1);
+        const size_t first = item.find_first_not_of(" \t");
+        if(first == std::string_view::npos) {
+            continue;
+        }
+        item = item.substr(first, item.find_last_not_of(" \t") - first + 1);
+        fn(item);
+    }
+}
+
+}  // namespace detail
+
+// Совпадает ли etag с одним из тегов заголовка If-None-Match. Как требует
+// RFC 7232, теги сравниваются без учёта признака слабого тега W/.
+inline bool MatchesIfNoneMatch(std::string_view if_none_match, std::string_view etag) {
+    bool matches = false;
+    detail::ForEachListItem(if_none_match, [&](std::string_view tag) {
+        if(tag.starts_with("W/")) {
+            tag.remove_prefix(2);
+        }
+        matches = matches || tag == "*" || tag == etag;
+    });
+    return matches;
+}
+
+// Принимает ли клиент gzip по заголовку Accept-Encoding (q=0 означает отказ)
+inline bool AcceptsGzip(std::string_view accept_encoding) {
+    bool accepts = false;
+    detail::ForEachListItem(accept_encoding, [&](std::string_view coding) {
+        const size_t params = coding.find(';');
+        std::string_view name = coding.substr(0, params);
+        name = name.substr(0, name.find_last_not_of(" \t") + 1);
+        if(name != "gzip" && name != "x-gzip") {
+            return;
+        }
+        bool refused = false;
+        if(params != std::string_view::npos) {
+            std::string_view q = coding.substr(params + 1);
+            q.remove_prefix(std::min(q.find_first_not_of(" \t"), q.size()));
+            // q=0, q=0.0, q=0.000 и т. п.
+            refused = q.starts_with("q=0") && q.substr(3).find_first_not_of(".0") == std::string_view::npos;
+        }
+        accepts = !refused;
+    });
+    return accepts;
+}
+
+}  // namespace http_handler
@@ -62,12 +62,33 @@ public:
 
         try {
             if (req_type == RequestType::API) {
+                // В strand игры идут только изменения и чтения, для которых нет
+                // актуального опубликованного ответа; остальное выполняется
+                // параллельно в потоках io_context
+                switch (GetApiExecution(DetermineApiObject(req_target))) {
+                    case ApiExecution::IMMUTABLE:
+                        return send(HandleApiRequest(req, req_target));
+                    case ApiExecution::PUBLISHED:
+                        if (auto response = api_handler_->TryHandlePublished(req, req_target)) {
+                            // Как и ответы из strand, не раньше записи в журнал показанных изменений
+                            return game_server_.AfterJournalCommit([send, response = std::move(*response)]() mutable {
+                                send(std::move(response));
+                            });
+                        }
+                        break;
+                    case ApiExecution::GAME_STRAND:
+                        break;
+                }
                 auto handle = [self = shared_from_this(), send,
                                req = std::forward<decltype(req)>(req), version, keep_alive, req_target] {
                     try {
                         // Этот assert не выстрелит, так как лямбда-функция будет выполняться внутри strand
                         assert(self->api_strand_.running_in_this_thread());
-                        return send(self->HandleApiRequest(req, req_target));
+                        // Ответ отправляется после того, как изменения попали в журнал действий
+                        self->game_server_.AfterJournalCommit([send, response = self->HandleApiRequest(req, req_target)]() mutable {
+                            send(std::move(response));
+                        });
+                        return;
                         //return send(self->api_handler_->HandleRequest(req, req_target));
                     } catch (const std::exception& ex) {
                         send(self->ReportServerError(version, keep_alive, ex.what()));
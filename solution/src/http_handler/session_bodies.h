@@ -0,0 +1,68 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "../domain_model/tagged.h"
+#include "../domain_model/model_game.h"
+#include "../application_model/game.h"
+
+namespace http_handler {
+
+// Ответы /api/v1/game/state и /api/v1/game/players одинаковы для всех игроков
+// сессии. Тело собирается в strand игры и публикуется с версией состояния
+// сессии (GameSession::GetStateVersion), при которой собрано. Пока версия не
+// изменилась, его отдают из любого потока.
+struct SessionBody {
+    enum Kind {
+        STATE,
+        PLAYERS,
+        KINDS_COUNT
+    };
+    uint64_t version = 0;
+    std::string body;
+};
+
+class SessionBodies {
+public:
+    // Сессия на карту одна, поэтому записи создаются сразу для всех карт, а
+    // потом таблица только читается
+    explicit SessionBodies(const model::Game::Maps& maps) {
+        for (const auto& map : maps) {
+            bodies_.emplace(map->GetId(), std::make_unique<Published>());
+        }
+    }
+
+    // Опубликованное тело, если оно соответствует текущей версии сессии; из любого потока
+    std::shared_ptr<const SessionBody> Find(const model::GameSession& session, SessionBody::Kind kind) const {
+        // Тело загружается до версии: если strand игры успел изменить сессию после
+        // публикации, версии не совпадут и запрос уйдёт в strand
+        std::shared_ptr<const SessionBody> body = Get(session, kind).load(std::memory_order_acquire);
+        if (body && body->version == session.GetStateVersion()) {
+            return body;
+        }
+        return nullptr;
+    }
+
+    // Публикует тело, собранное при текущей версии сессии; только в strand игры
+    std::shared_ptr<const SessionBody> Publish(const model::GameSession& session, SessionBody::Kind kind, std::string body) const {
+        auto published = std::make_shared<const SessionBody>(SessionBody{session.GetStateVersion(), std::move(body)});
+        Get(session, kind).store(published, std::memory_order_release);
+        return published;
+    }
+
+private:
+    using Published = std::array<std::atomic<std::shared_ptr<const SessionBody>>, SessionBody::KINDS_COUNT>;
+
+    std::unordered_map<model::Map::Id, std::unique_ptr<Published>, util::TaggedHasher<model::Map::Id>> bodies_;
+
+    std::atomic<std::shared_ptr<const SessionBody>>& Get(const model::GameSession& session, SessionBody::Kind kind) const {
+        return (*bodies_.at(session.GetMap()->GetId()))[kind];
+    }
+};
+
+}  // namespace http_handler
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <boost/json.hpp>
+
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Гистограмма задержек с логарифмическими корзинами: корзина i хранит
+// замеры из диапазона [2^i, 2^(i+1)) микросекунд. Не потокобезопасна,
+// каждый поток должен писать в свою гистограмму.
+class LatencyHistogram {
+public:
+    static constexpr size_t BUCKETS_COUNT = 24;
+
+    void Add(std::chrono::microseconds latency) {
+        const uint64_t us = latency.count() > 0 ? static_cast<uint64_t>(latency.count()) : 0;
+        const size_t bucket = us ? std::min<size_t>(std::bit_width(us) - 1, BUCKETS_COUNT - 1) : 0;
+        ++buckets_[bucket];
+        ++count_;
+        total_us_ += us;
+        max_us_ = std::max(max_us_, us);
+    }
+
+    uint64_t Count() const noexcept {
+        return count_;
+    }
+
+    // Верхняя граница корзины, в которую попадает перцентиль p (0..1)
+    uint64_t PercentileUs(double p) const noexcept {
+        if (count_ == 0) {
+            return 0;
+        }
+        const uint64_t rank = static_cast<uint64_t>(p * static_cast<double>(count_ - 1)) + 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKETS_COUNT; ++i) {
+            seen += buckets_[i];
+            if (seen >= rank) {
+                return std::min(uint64_t{2} << i, max_us_);
+            }
+        }
+        return max_us_;
+    }
+
+    void Reset() {
+        *this = LatencyHistogram{};
+    }
+
+    boost::json::object ToJson() const {
+        boost::json::object result;
+        result["count"] = count_;
+        result["mean_us"] = count_ ? total_us_ / count_ : 0;
+        result["p50_us"] = PercentileUs(0.5);
+        result["p90_us"] = PercentileUs(0.9);
+        result["p99_us"] = PercentileUs(0.99);
+        result["max_us"] = max_us_;
+
+        boost::json::object buckets;
+        for (size_t i = 0; i < BUCKETS_COUNT; ++i) {
+            if (buckets_[i]) {
+                buckets["<" + std::to_string(uint64_t{2} << i) + "us"] = buckets_[i];
+            }
+        }
+        result["buckets"] = buckets;
+        return result;
+    }
+
+private:
+    std::array<uint64_t, BUCKETS_COUNT> buckets_{};
+    uint64_t count_ = 0;
+    uint64_t total_us_ = 0;
+    uint64_t max_us_ = 0;
+};
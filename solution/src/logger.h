@@ -1,3 +1,5 @@
+#pragma once
+
 #include <boost/log/trivial.hpp>     // для BOOST_LOG_TRIVIAL
 #include <boost/log/core.hpp>        // для logging::core
 #include <boost/log/expressions.hpp> // для выражения, задающего фильтр
@@ -18,6 +20,9 @@
 
 #include <string_view>
 
+#include "latency_histogram.h"
+#include "ticker.h"
+
 using namespace std::literals;
 
 namespace logging = boost::log;
@@ -58,6 +63,46 @@ public:
         BOOST_LOG_TRIVIAL(info) << logging::add_value(additional_data, add_data) << "server exited";
     }
 
+    static void LogStateRestored(const std::string& state_file) {
+        boost::json::object add_data;
+        add_data["state_file"] = state_file;
+        BOOST_LOG_TRIVIAL(info) << logging::add_value(additional_data, add_data) << "state restored";
+    }
+
+    static void LogSnapshotLatency(std::string_view phase, const LatencyHistogram& histogram) {
+        boost::json::object add_data = histogram.ToJson();
+        add_data["phase"] = phase;
+        BOOST_LOG_TRIVIAL(info) << logging::add_value(additional_data, add_data) << "snapshot latency";
+    }
+
+    static void LogTickerStats(const TickerStats& stats) {
+        boost::json::object add_data;
+        add_data["steps"] = stats.steps;
+        add_data["overruns"] = stats.overruns;
+        add_data["skipped_steps"] = stats.skipped_steps;
+        add_data["lag_ms"] = stats.lag.count();
+        add_data["max_lag_ms"] = stats.max_lag.count();
+        BOOST_LOG_TRIVIAL(info) << logging::add_value(additional_data, add_data) << "ticker stats";
+    }
+
+    static void LogSnapshotError(const std::exception& ex) {
+        boost::json::object add_data;
+        add_data["exception"] = ex.what();
+        BOOST_LOG_TRIVIAL(error) << logging::add_value(additional_data, add_data) << "snapshot failed";
+    }
+
+    static void LogJournalReplayed(size_t records) {
+        boost::json::object add_data;
+        add_data["records"] = records;
+        BOOST_LOG_TRIVIAL(info) << logging::add_value(additional_data, add_data) << "journal replayed";
+    }
+
+    static void LogJournalError(const std::exception& ex) {
+        boost::json::object add_data;
+        add_data["exception"] = ex.what();
+        BOOST_LOG_TRIVIAL(error) << logging::add_value(additional_data, add_data) << "journal write failed";
+    }
+
 private:
     typedef sinks::synchronous_sink< sinks::text_file_backend > sink_t;
     boost::shared_ptr<sink_t> g_file_sink;
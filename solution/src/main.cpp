@@ -66,11 +66,18 @@ int main(int argc, const char* argv[]) {
         bool random_spawn = command_line_args.random_spawn;
 
         GameServer game_server(config);
+        game_server.SetTickThreads(command_line_args.tick_threads);
 
         if (tick_period) {
             std::chrono::milliseconds tick_period_millisec(tick_period);
+            std::optional<FixedStep> fixed_step;
+            if (command_line_args.tick_mode == "fixed"sv) {
+                fixed_step = FixedStep{.max_steps = command_line_args.tick_max_steps,
+                                       .merge = command_line_args.tick_overflow == "merge"sv};
+            }
             auto ticker = std::make_shared<Ticker>(api_strand, tick_period_millisec, [&game_server](std::chrono::milliseconds delta) 
-                                                                                                    {game_server.Tick(delta);});
+                                                                                                    {game_server.Tick(delta);}, fixed_step);
+            ticker->SetStatsHandler(&Logger::LogTickerStats);
             game_server.SetAutoTick();
             ticker->Start();
         }
@@ -82,8 +89,19 @@ int main(int argc, const char* argv[]) {
         }
         if(!command_line_args.state_file_path.empty()) {
             game_server.SetStateFile(state.string());
-            if(std::filesystem::exists(state)) {
-                game_server.Restore();
+            game_server.SetSnapshotOptions({.format = model::ParseSnapshotFormat(command_line_args.state_format),
+                                            .generations = command_line_args.state_generations,
+                                            .delta_count = command_line_args.state_delta_count,
+                                            .compression_level = command_line_args.state_compression,
+                                            .threads = command_line_args.state_threads});
+            if(command_line_args.state_journal != "off"sv) {
+                game_server.SetJournalSyncPolicy(model::ParseJournalSyncPolicy(command_line_args.state_journal));
+            }
+            if(auto restored_file = game_server.Restore()) {
+                Logger::LogStateRestored(*restored_file);
+            }
+            if(game_server.GetReplayedJournalRecords()) {
+                Logger::LogJournalReplayed(game_server.GetReplayedJournalRecords());
             }
         }
 
@@ -93,12 +111,15 @@ int main(int argc, const char* argv[]) {
 
             conn1 = game_server.DoOnTick([total = 0ms, save_period, &game_server](milliseconds delta) mutable {
                 total += delta;
-                if(save_period <= delta){
-                    game_server.Save();
+                if(save_period <= total){
+                    total = 0ms;
+                    game_server.SaveAsync();
                 }
-                
             });
         }
+        sig::scoped_connection snapshot_stats_conn = game_server.DoOnSnapshotStats(&Logger::LogSnapshotLatency);
+        sig::scoped_connection snapshot_error_conn = game_server.DoOnSnapshotError(&Logger::LogSnapshotError);
+        sig::scoped_connection journal_error_conn = game_server.DoOnJournalError(&Logger::LogJournalError);
 
         // 3. Добавляем асинхронный обработчик сигналов SIGINT и SIGTERM
         net::signal_set signals(ioc, SIGINT, SIGTERM);
@@ -0,0 +1,325 @@
+#include "action_journal.h"
+
+#include <boost/archive/binary_iarchive.hpp>
+
+#include <fcntl.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+using namespace std::literals;
+
+namespace model {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+// Сегмент начинается с сигнатуры и номера первой записи, затем идут записи
+// вида [размер тела u32][crc тела u32][тип u8][номер записи u64][архив записи]
+constexpr char JOURNAL_MAGIC[8] = {'G', 'S', 'J', 'R', 'N', 'L', '\0', '\1'};
+constexpr size_t FRAME_HEADER_SIZE = sizeof(uint32_t) * 2;
+constexpr size_t BODY_HEADER_SIZE = sizeof(uint8_t) + sizeof(uint64_t);
+
+std::vector<std::pair<uint64_t, std::string>> ListJournalSegments(const std::string& filename) {
+    const fs::path path(filename);
+    fs::path dir = path.parent_path();
+    if (dir.empty()) {
+        dir = ".";
+    }
+    const std::string prefix = path.filename().string() + ".journal.";
+
+    std::vector<std::pair<uint64_t, std::string>> segments;
+    if (!fs::is_directory(dir)) {
+        return segments;
+    }
+    for (const auto& entry : fs::directory_iterator(dir)) {
+        const std::string name = entry.path().filename().string();
+        if (!name.starts_with(prefix) || name.size() == prefix.size()) {
+            continue;
+        }
+        const std::string_view suffix = std::string_view(name).substr(prefix.size());
+        if (!std::all_of(suffix.begin(), suffix.end(), [](unsigned char c) { return std::isdigit(c); })) {
+            continue;
+        }
+        segments.emplace_back(std::stoull(std::string(suffix)), entry.path().string());
+    }
+    std::sort(segments.begin(), segments.end());
+    return segments;
+}
+
+template <typename Record>
+Record ReadRecord(std::string_view payload) {
+    std::istringstream in{std::string(payload), std::ios_base::in | std::ios_base::binary};
+    boost::archive::binary_iarchive ia{in, boost::archive::no_header};
+    Record record;
+    ia >> record;
+    return record;
+}
+
+void ApplyRecord(Game& game, JournalRecordType type, std::string_view payload) {
+    constexpr double millisec_per_sec = 1000.;
+
+    switch (type) {
+        case JournalRecordType::JOIN: {
+            const JoinRecord record = ReadRecord<JoinRecord>(payload);
+            RestorePlayer(game, record.GetMapIdString(), record.GetPlayerRepr());
+            break;
+        }
+        case JournalRecordType::ACTION: {
+            const ActionRecord record = ReadRecord<ActionRecord>(payload);
+            if (std::shared_ptr<const Player> player = game.FindPlayer(record.GetPlayerId())) {
+                game.ApplyPlayerAction(*player, record.GetDirection());
+            }
+            break;
+        }
+        case JournalRecordType::TICK: {
+            const TickRecord record = ReadRecord<TickRecord>(payload);
+            // Тот же порядок, что и в GameServer::Tick: сначала новые предметы, потом движение
+            for (const auto& session_loot : record.GetGeneratedLoot()) {
+                std::shared_ptr<GameSession> session = game.GetGameSession(Map::Id{session_loot.GetMapIdString()});
+                for (const auto& loot_object_repr : session_loot.GetLootsObjectRepr()) {
+                    LootObject loot_object = loot_object_repr.Restore();
+                    session->AddLootObject(loot_object);
+                }
+            }
+            game.UpdateGame(static_cast<double>(record.GetTimeDelta()) / millisec_per_sec);
+            break;
+        }
+        default:
+            throw std::runtime_error("Unknown journal record type");
+    }
+}
+
+}  // namespace
+
+JournalSyncPolicy ParseJournalSyncPolicy(std::string_view name) {
+    if (name == "never"sv) {
+        return JournalSyncPolicy::NEVER;
+    }
+    if (name == "batch"sv) {
+        return JournalSyncPolicy::BATCH;
+    }
+    if (name == "always"sv) {
+        return JournalSyncPolicy::ALWAYS;
+    }
+    throw std::invalid_argument("Unknown journal sync policy: "s + std::string(name));
+}
+
+std::string GetJournalSegmentName(const std::string& filename, uint64_t first_lsn) {
+    return filename + ".journal." + std::to_string(first_lsn);
+}
+
+void RemoveJournalSegments(const std::string& filename, uint64_t before_lsn) {
+    for (const auto& [first_lsn, segment] : ListJournalSegments(filename)) {
+        // Сегменты начинаются там, где снимался снимок, поэтому сегмент,
+        // начавшийся раньше before_lsn, целиком вошёл в снимок
+        if (first_lsn >= before_lsn) {
+            break;
+        }
+        fs::remove(segment);
+    }
+}
+
+JournalReplayResult ReplayJournal(Game& game, const std::string& filename, uint64_t from_lsn) {
+    JournalReplayResult result{from_lsn, 0};
+
+    for (const auto& [first_lsn, segment] : ListJournalSegments(filename)) {
+        if (first_lsn > result.next_lsn) {
+            // Записи между снимком и этим сегментом потеряны
+            break;
+        }
+
+        std::ifstream in(segment, std::ios_base::in | std::ios_base::binary);
+        char magic[sizeof(JOURNAL_MAGIC)];
+        uint64_t header_lsn = 0;
+        in.read(magic, sizeof(magic));
+        in.read(reinterpret_cast<char*>(&header_lsn), sizeof(header_lsn));
+        if (!in || std::memcmp(magic, JOURNAL_MAGIC, sizeof(magic)) != 0 || header_lsn != first_lsn) {
+            continue;
+        }
+
+        std::string body;
+        while (true) {
+            uint32_t body_size = 0;
+            uint32_t body_crc = 0;
+            in.read(reinterpret_cast<char*>(&body_size), sizeof(body_size));
+            in.read(reinterpret_cast<char*>(&body_crc), sizeof(body_crc));
+            if (!in || body_size < BODY_HEADER_SIZE) {
+                break;
+            }
+            body.resize(body_size);
+            in.read(body.data(), body.size());
+            if (!in || Crc32(body.data(), body.size()) != body_crc) {
+                break;
+            }
+
+            const auto type = static_cast<JournalRecordType>(body[0]);
+            uint64_t lsn = 0;
+            std::memcpy(&lsn, body.data() + sizeof(uint8_t), sizeof(lsn));
+            if (lsn < result.next_lsn) {
+                continue;
+            }
+            if (lsn != result.next_lsn) {
+                return result;
+            }
+
+            ApplyRecord(game, type, std::string_view(body).substr(BODY_HEADER_SIZE));
+            ++result.next_lsn;
+            ++result.records;
+        }
+    }
+    return result;
+}
+
+ActionJournal::ActionJournal(std::string filename, JournalSyncPolicy policy, uint64_t next_lsn, ErrorHandler on_error)
+    : filename_(std::move(filename))
+    , policy_(policy)
+    , on_error_(std::move(on_error))
+    , next_lsn_(next_lsn)
+    , committed_lsn_(next_lsn - 1) {
+    pending_.push_back(Batch{{}, next_lsn});
+    thread_ = std::jthread([this](std::stop_token stop) { Run(stop); });
+}
+
+ActionJournal::~ActionJournal() {
+    Flush();
+    thread_.request_stop();
+}
+
+uint64_t ActionJournal::AppendPayload(JournalRecordType type, std::string_view payload) {
+    std::string frame(FRAME_HEADER_SIZE + BODY_HEADER_SIZE + payload.size(), '\0');
+    char* body = frame.data() + FRAME_HEADER_SIZE;
+    const auto body_size = static_cast<uint32_t>(BODY_HEADER_SIZE + payload.size());
+    body[0] = static_cast<char>(type);
+    std::memcpy(body + BODY_HEADER_SIZE, payload.data(), payload.size());
+    std::memcpy(frame.data(), &body_size, sizeof(body_size));
+
+    uint64_t lsn = 0;
+    {
+        std::lock_guard lock(mutex_);
+        lsn = next_lsn_++;
+        std::memcpy(body + sizeof(uint8_t), &lsn, sizeof(lsn));
+        const uint32_t body_crc = Crc32(body, body_size);
+        std::memcpy(frame.data() + sizeof(body_size), &body_crc, sizeof(body_crc));
+
+        if (pending_.empty()) {
+            pending_.push_back(Batch{});
+        }
+        pending_.back().data += frame;
+    }
+    data_ready_.notify_one();
+    return lsn;
+}
+
+uint64_t ActionJournal::Rotate() {
+    uint64_t first_lsn = 0;
+    {
+        std::lock_guard lock(mutex_);
+        first_lsn = next_lsn_;
+        pending_.push_back(Batch{{}, first_lsn});
+    }
+    data_ready_.notify_one();
+    return first_lsn;
+}
+
+void ActionJournal::WhenCommitted(CommitHandler callback) {
+    std::unique_lock lock(mutex_);
+    if (policy_ != JournalSyncPolicy::ALWAYS || committed_lsn_ + 1 >= next_lsn_) {
+        lock.unlock();
+        callback();
+        return;
+    }
+    waiting_.emplace_back(next_lsn_ - 1, std::move(callback));
+}
+
+void ActionJournal::Flush() {
+    std::unique_lock lock(mutex_);
+    idle_.wait(lock, [this] {
+        return pending_.empty() && !busy_;
+    });
+}
+
+void ActionJournal::OpenSegment(uint64_t first_lsn) {
+    if (segment_) {
+        if (policy_ != JournalSyncPolicy::NEVER) {
+            segment_->Sync();
+        }
+        segment_->Close();
+        segment_.reset();
+    }
+
+    const std::string segment_name = GetJournalSegmentName(filename_, first_lsn);
+    segment_.emplace(segment_name, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    segment_->WriteAll(JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+    segment_->WriteAll(&first_lsn, sizeof(first_lsn));
+    if (policy_ != JournalSyncPolicy::NEVER) {
+        segment_->Sync();
+        SyncDirectory(segment_name);
+    }
+}
+
+void ActionJournal::WriteBatches(const std::deque<Batch>& batches) {
+    for (const Batch& batch : batches) {
+        if (batch.new_segment) {
+            OpenSegment(*batch.new_segment);
+        }
+        if (batch.data.empty()) {
+            continue;
+        }
+        if (!segment_) {
+            throw std::runtime_error("Journal segment is not open");
+        }
+        segment_->WriteAll(batch.data.data(), batch.data.size());
+    }
+    if (segment_ && policy_ != JournalSyncPolicy::NEVER) {
+        segment_->Sync();
+    }
+}
+
+void ActionJournal::Run(std::stop_token stop) {
+    std::unique_lock lock(mutex_);
+    while (true) {
+        if (!data_ready_.wait(lock, stop, [this] { return !pending_.empty(); })) {
+            return;
+        }
+        std::deque<Batch> batches;
+        batches.swap(pending_);
+        const uint64_t last_lsn = next_lsn_ - 1;
+        busy_ = true;
+        lock.unlock();
+
+        try {
+            WriteBatches(batches);
+        } catch (const std::exception& ex) {
+            // Ответы всё равно отправляются: сервер продолжает работу,
+            // а ошибка записи попадает в лог
+            if (on_error_) {
+                on_error_(ex);
+            }
+        }
+
+        lock.lock();
+        committed_lsn_ = last_lsn;
+        std::vector<CommitHandler> committed;
+        while (!waiting_.empty() && waiting_.front().first <= committed_lsn_) {
+            committed.push_back(std::move(waiting_.front().second));
+            waiting_.pop_front();
+        }
+        busy_ = false;
+        if (pending_.empty()) {
+            idle_.notify_all();
+        }
+        lock.unlock();
+
+        for (auto& callback : committed) {
+            callback();
+        }
+        lock.lock();
+    }
+}
+
+}  // namespace model
@@ -0,0 +1,253 @@
+#pragma once
+
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/serialization/string.hpp>
+#include <boost/serialization/vector.hpp>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../application_model/game.h"
+#include "model_serialization.h"
+#include "snapshot_file.h"
+
+namespace model {
+
+// Журнал действий (write-ahead log) между снимками состояния. Каждая запись
+// хранит не только само действие, но и его случайные последствия (токен и
+// место появления собаки, сгенерированные предметы), поэтому повторное
+// применение записей к снимку даёт то же состояние.
+enum class JournalRecordType : uint8_t {
+    JOIN = 1,
+    ACTION = 2,
+    TICK = 3
+};
+
+class JoinRecord {
+public:
+    static constexpr JournalRecordType TYPE = JournalRecordType::JOIN;
+
+    JoinRecord() = default;
+
+    JoinRecord(const Map::Id& map_id, const Player& player, const Token& token)
+        : map_id_str_(*map_id)
+        , player_repr_(player, token) {
+    }
+
+    [[nodiscard]] const std::string& GetMapIdString() const {
+        return map_id_str_;
+    }
+    [[nodiscard]] const PlayerReprTmp& GetPlayerRepr() const {
+        return player_repr_;
+    }
+
+    template <typename Archive>
+    void serialize(Archive& ar, [[maybe_unused]] const unsigned version) {
+        ar& map_id_str_;
+        ar& player_repr_;
+    }
+
+private:
+    std::string map_id_str_;
+    PlayerReprTmp player_repr_;
+};
+
+class ActionRecord {
+public:
+    static constexpr JournalRecordType TYPE = JournalRecordType::ACTION;
+
+    ActionRecord() = default;
+
+    ActionRecord(int player_id, std::string direction)
+        : player_id_(player_id)
+        , direction_(std::move(direction)) {
+    }
+
+    [[nodiscard]] int GetPlayerId() const {
+        return player_id_;
+    }
+    [[nodiscard]] const std::string& GetDirection() const {
+        return direction_;
+    }
+
+    template <typename Archive>
+    void serialize(Archive& ar, [[maybe_unused]] const unsigned version) {
+        ar& player_id_;
+        ar& direction_;
+    }
+
+private:
+    int player_id_ = 0;
+    std::string direction_;
+};
+
+class SessionLootRepr {
+public:
+    SessionLootRepr() = default;
+
+    SessionLootRepr(const Map::Id& map_id, std::span<const std::shared_ptr<LootObject>> loot_objects)
+        : map_id_str_(*map_id) {
+        loot_objects_repr_.reserve(loot_objects.size());
+        for(const auto& loot_object : loot_objects) {
+            loot_objects_repr_.emplace_back(*loot_object);
+        }
+    }
+
+    [[nodiscard]] const std::string& GetMapIdString() const {
+        return map_id_str_;
+    }
+    [[nodiscard]] const std::vector<LootObjectRepr>& GetLootsObjectRepr() const {
+        return loot_objects_repr_;
+    }
+
+    template <typename Archive>
+    void serialize(Archive& ar, [[maybe_unused]] const unsigned version) {
+        ar& map_id_str_;
+        ar& loot_objects_repr_;
+    }
+
+private:
+    std::string map_id_str_;
+    std::vector<LootObjectRepr> loot_objects_repr_;
+};
+
+class TickRecord {
+public:
+    static constexpr JournalRecordType TYPE = JournalRecordType::TICK;
+
+    TickRecord() = default;
+
+    TickRecord(int64_t time_delta_ms, const Game::GeneratedLoot& generated_loot)
+        : time_delta_ms_(time_delta_ms) {
+        generated_loot_.reserve(generated_loot.size());
+        for(const auto& [map_id, loot_objects] : generated_loot) {
+            generated_loot_.emplace_back(map_id, loot_objects);
+        }
+    }
+
+    [[nodiscard]] int64_t GetTimeDelta() const {
+        return time_delta_ms_;
+    }
+    [[nodiscard]] const std::vector<SessionLootRepr>& GetGeneratedLoot() const {
+        return generated_loot_;
+    }
+
+    template <typename Archive>
+    void serialize(Archive& ar, [[maybe_unused]] const unsigned version) {
+        ar& time_delta_ms_;
+        ar& generated_loot_;
+    }
+
+private:
+    int64_t time_delta_ms_ = 0;
+    std::vector<SessionLootRepr> generated_loot_;
+};
+
+// Когда журнал сбрасывается на диск:
+// NEVER  - записи пишутся в файл группами без fsync (переживают падение процесса, но не системы);
+// BATCH  - каждая группа записей сбрасывается fsync, ответы клиентам её не ждут;
+// ALWAYS - ответ на запрос отправляется только после fsync группы, в которую попала его запись.
+enum class JournalSyncPolicy {
+    NEVER,
+    BATCH,
+    ALWAYS
+};
+
+JournalSyncPolicy ParseJournalSyncPolicy(std::string_view name);
+
+// Сегмент журнала filename, начинающийся с записи first_lsn
+std::string GetJournalSegmentName(const std::string& filename, uint64_t first_lsn);
+// Удаляет сегменты журнала, все записи которых имеют номера меньше before_lsn
+void RemoveJournalSegments(const std::string& filename, uint64_t before_lsn = UINT64_MAX);
+
+struct JournalReplayResult {
+    // Номер записи, с которой журнал нужно продолжать
+    uint64_t next_lsn = 1;
+    size_t records = 0;
+};
+
+// Применяет к игре записи журнала, начиная с from_lsn, пока номера идут подряд.
+// Оборванная или повреждённая запись в конце сегмента (незавершённая запись
+// при падении) пропускается вместе с остатком сегмента.
+JournalReplayResult ReplayJournal(Game& game, const std::string& filename, uint64_t from_lsn);
+
+// Дописывает записи в текущий сегмент журнала в отдельном потоке.
+// Append и Rotate вызываются из api_strand и только ставят запись в очередь:
+// всё, что накопилось за время предыдущей записи, уходит на диск одной группой.
+class ActionJournal {
+public:
+    using ErrorHandler = std::function<void(const std::exception& ex)>;
+    using CommitHandler = std::function<void()>;
+
+    ActionJournal(std::string filename, JournalSyncPolicy policy, uint64_t next_lsn, ErrorHandler on_error);
+
+    ActionJournal(const ActionJournal&) = delete;
+    ActionJournal& operator=(const ActionJournal&) = delete;
+
+    // Дописывает ожидающие записи и останавливает поток
+    ~ActionJournal();
+
+    template <typename Record>
+    uint64_t Append(const Record& record) {
+        std::ostringstream out(std::ios_base::out | std::ios_base::binary);
+        {
+            boost::archive::binary_oarchive oa{out, boost::archive::no_header};
+            oa << record;
+        }
+        return AppendPayload(Record::TYPE, out.view());
+    }
+
+    // Начинает новый сегмент и возвращает номер его первой записи.
+    // Все записи с меньшими номерами должны войти в снимок, который снимается сейчас.
+    uint64_t Rotate();
+
+    // При политике ALWAYS откладывает callback до fsync всех уже добавленных записей,
+    // иначе вызывает его сразу. Отложенный callback вызывается из потока журнала.
+    void WhenCommitted(CommitHandler callback);
+
+    // Блокирует вызывающий поток, пока все добавленные записи не будут записаны
+    void Flush();
+
+private:
+    // Группа записей; если задан new_segment, перед ними открывается новый сегмент
+    struct Batch {
+        std::string data;
+        std::optional<uint64_t> new_segment;
+    };
+
+    uint64_t AppendPayload(JournalRecordType type, std::string_view payload);
+    void Run(std::stop_token stop);
+    void WriteBatches(const std::deque<Batch>& batches);
+    void OpenSegment(uint64_t first_lsn);
+
+    std::string filename_;
+    JournalSyncPolicy policy_;
+    ErrorHandler on_error_;
+
+    std::mutex mutex_;
+    std::condition_variable_any data_ready_;
+    std::condition_variable idle_;
+    std::deque<Batch> pending_;
+    bool busy_ = false;
+    uint64_t next_lsn_;
+    uint64_t committed_lsn_;
+    std::deque<std::pair<uint64_t, CommitHandler>> waiting_;
+
+    // Используется только потоком журнала
+    std::optional<FileDescriptor> segment_;
+
+    std::jthread thread_;
+};
+
+}  // namespace model
@@ -0,0 +1,306 @@
+#include "flat_snapshot.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+
+using namespace std::literals;
+
+namespace model {
+
+namespace {
+
+constexpr char FLAT_MAGIC[8] = {'G', 'S', 'F', 'L', 'A', 'T', '\0', '\1'};
+
+// Ссылка на строку в таблице строк
+struct FlatString {
+    uint32_t offset;
+    uint32_t size;
+};
+
+struct FlatHeader {
+    char magic[8];
+    uint64_t session_count;
+    uint64_t player_count;
+    // Предметы на картах и в рюкзаках
+    uint64_t loot_count;
+    uint64_t strings_size;
+};
+
+struct FlatSession {
+    FlatString map_id;
+    uint64_t first_player;
+    uint64_t player_count;
+    uint64_t first_loot;
+    uint64_t loot_count;
+};
+
+struct FlatLoot {
+    int32_t id;
+    int32_t type;
+    int32_t value;
+    int32_t id_counter;
+    double x;
+    double y;
+    double width;
+};
+
+struct FlatPlayer {
+    FlatString name;
+    FlatString token;
+    int32_t id;
+    int32_t id_counter;
+    int32_t dog_id;
+    int32_t dog_id_counter;
+    double x;
+    double y;
+    double speed_x;
+    double speed_y;
+    double speed_value;
+    double gatherer_start_x;
+    double gatherer_start_y;
+    double gatherer_end_x;
+    double gatherer_end_y;
+    double gatherer_width;
+    int32_t direction;
+    int32_t score;
+    int32_t bag_capacity;
+    uint32_t bag_size;
+    uint64_t first_bag_loot;
+};
+
+template <typename... Records>
+constexpr bool IsFlatLayout() {
+    return ((std::is_trivially_copyable_v<Records> && sizeof(Records) % alignof(uint64_t) == 0) && ...);
+}
+static_assert(IsFlatLayout<FlatHeader, FlatSession, FlatLoot, FlatPlayer>());
+
+class StringTable {
+public:
+    FlatString Add(std::string_view str) {
+        FlatString ref{static_cast<uint32_t>(data_.size()), static_cast<uint32_t>(str.size())};
+        data_ += str;
+        return ref;
+    }
+
+    const std::string& GetData() const {
+        return data_;
+    }
+
+private:
+    std::string data_;
+};
+
+FlatLoot MakeFlatLoot(const LootObjectRepr& loot_repr, int id_counter) {
+    const collision_detector::Item& item = loot_repr.GetItem();
+    return {loot_repr.GetId(), loot_repr.GetType(), loot_repr.GetValue(), id_counter,
+            item.position.x, item.position.y, item.width};
+}
+
+template <typename Record>
+void WriteRecords(std::ostream& out, const std::vector<Record>& records) {
+    out.write(reinterpret_cast<const char*>(records.data()), static_cast<std::streamsize>(records.size() * sizeof(Record)));
+}
+
+LootObject RestoreLootObject(const FlatLoot& flat_loot) {
+    LootObject loot_object(flat_loot.type, flat_loot.value, geom::Point2D{flat_loot.x, flat_loot.y}, flat_loot.width);
+    loot_object.SetId(flat_loot.id);
+    loot_object.SetIdCounter(flat_loot.id_counter);
+    return loot_object;
+}
+
+struct FlatArrays {
+    const FlatHeader* header;
+    const FlatSession* sessions;
+    const FlatPlayer* players;
+    const FlatLoot* loot;
+    const char* strings;
+
+    std::string_view GetString(FlatString ref) const {
+        return {strings + ref.offset, ref.size};
+    }
+};
+
+FlatArrays GetArrays(std::string_view data) {
+    FlatArrays arrays{};
+    arrays.header = reinterpret_cast<const FlatHeader*>(data.data());
+    arrays.sessions = reinterpret_cast<const FlatSession*>(arrays.header + 1);
+    arrays.players = reinterpret_cast<const FlatPlayer*>(arrays.sessions + arrays.header->session_count);
+    arrays.loot = reinterpret_cast<const FlatLoot*>(arrays.players + arrays.header->player_count);
+    arrays.strings = reinterpret_cast<const char*>(arrays.loot + arrays.header->loot_count);
+    return arrays;
+}
+
+bool IsRangeValid(uint64_t first, uint64_t count, uint64_t size) {
+    return first <= size && count <= size - first;
+}
+
+}  // namespace
+
+void WriteFlatSnapshot(std::span<const GameSessionReprTmp> game_ses_reprs, std::ostream& out) {
+    std::vector<FlatSession> sessions;
+    std::vector<FlatPlayer> players;
+    std::vector<FlatLoot> loot;
+    StringTable strings;
+
+    sessions.reserve(game_ses_reprs.size());
+    for(const auto& session_repr : game_ses_reprs) {
+        FlatSession& flat_session = sessions.emplace_back();
+        flat_session.map_id = strings.Add(session_repr.GetMapIdString());
+        // Плоский формат по-прежнему хранит счётчики в каждой записи
+        const IdCounters& id_counters = session_repr.GetIdCounters();
+
+        flat_session.first_loot = loot.size();
+        for(const auto& loot_repr : session_repr.GetLootsObjectRepr()) {
+            loot.push_back(MakeFlatLoot(loot_repr, id_counters.loot_object));
+        }
+        flat_session.loot_count = loot.size() - flat_session.first_loot;
+
+        flat_session.first_player = players.size();
+        for(const auto& player_repr : session_repr.GetPlayerRepr()) {
+            const DogRepr& dog_repr = player_repr.GetDogRepr();
+            const collision_detector::Gatherer& gatherer = dog_repr.GetGatherer();
+
+            FlatPlayer& flat_player = players.emplace_back();
+            flat_player.name = strings.Add(player_repr.GetPlayerName());
+            flat_player.token = strings.Add(player_repr.GetPlayerToken());
+            flat_player.id = player_repr.GetPlayerId();
+            flat_player.id_counter = id_counters.player;
+            flat_player.dog_id = dog_repr.GetId();
+            flat_player.dog_id_counter = id_counters.dog;
+            flat_player.x = dog_repr.GetPosition().x;
+            flat_player.y = dog_repr.GetPosition().y;
+            flat_player.speed_x = dog_repr.GetSpeed().x;
+            flat_player.speed_y = dog_repr.GetSpeed().y;
+            flat_player.speed_value = dog_repr.GetSpeedValue();
+            flat_player.gatherer_start_x = gatherer.start_pos.x;
+            flat_player.gatherer_start_y = gatherer.start_pos.y;
+            flat_player.gatherer_end_x = gatherer.end_pos.x;
+            flat_player.gatherer_end_y = gatherer.end_pos.y;
+            flat_player.gatherer_width = gatherer.width;
+            flat_player.direction = static_cast<int32_t>(dog_repr.GetDirection());
+            flat_player.score = dog_repr.GetScore();
+
+            const BagRepr& bag_repr = dog_repr.GetBagRepr();
+            flat_player.bag_capacity = bag_repr.GetCapacity();
+            flat_player.bag_size = static_cast<uint32_t>(bag_repr.GetLootObjectsRepr().size());
+            flat_player.first_bag_loot = loot.size();
+            for(const auto& loot_repr : bag_repr.GetLootObjectsRepr()) {
+                loot.push_back(MakeFlatLoot(loot_repr, id_counters.loot_object));
+            }
+        }
+        flat_session.player_count = players.size() - flat_session.first_player;
+    }
+
+    // Таблица строк идёт последней, выравнивание массивов она не нарушает
+    FlatHeader header{};
+    std::memcpy(header.magic, FLAT_MAGIC, sizeof(header.magic));
+    header.session_count = sessions.size();
+    header.player_count = players.size();
+    header.loot_count = loot.size();
+    header.strings_size = strings.GetData().size();
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    WriteRecords(out, sessions);
+    WriteRecords(out, players);
+    WriteRecords(out, loot);
+    out.write(strings.GetData().data(), static_cast<std::streamsize>(strings.GetData().size()));
+}
+
+FlatSnapshot::FlatSnapshot(std::string_view data)
+    : data_(data) {
+    if(reinterpret_cast<uintptr_t>(data.data()) % alignof(FlatPlayer) != 0) {
+        throw std::runtime_error("Flat snapshot buffer is not aligned");
+    }
+    if(data.size() < sizeof(FlatHeader) || std::memcmp(data.data(), FLAT_MAGIC, sizeof(FLAT_MAGIC)) != 0) {
+        throw std::runtime_error("Flat snapshot has invalid header");
+    }
+
+    FlatHeader header;
+    std::memcpy(&header, data.data(), sizeof(header));
+    // Счётчики проверяются по отдельности, чтобы произведения не переполнились
+    uint64_t rest = data.size() - sizeof(header);
+    const auto take = [&rest](uint64_t count, uint64_t record_size) {
+        if(count > rest / record_size) {
+            throw std::runtime_error("Flat snapshot is truncated");
+        }
+        rest -= count * record_size;
+    };
+    take(header.session_count, sizeof(FlatSession));
+    take(header.player_count, sizeof(FlatPlayer));
+    take(header.loot_count, sizeof(FlatLoot));
+    if(rest != header.strings_size) {
+        throw std::runtime_error("Flat snapshot size mismatch");
+    }
+
+    const FlatArrays arrays = GetArrays(data_);
+    const auto check_string = [&header](FlatString ref) {
+        if(!IsRangeValid(ref.offset, ref.size, header.strings_size)) {
+            throw std::runtime_error("Flat snapshot has invalid string reference");
+        }
+    };
+    for(uint64_t i = 0; i < header.session_count; ++i) {
+        const FlatSession& session = arrays.sessions[i];
+        check_string(session.map_id);
+        if(!IsRangeValid(session.first_player, session.player_count, header.player_count)
+           || !IsRangeValid(session.first_loot, session.loot_count, header.loot_count)) {
+            throw std::runtime_error("Flat snapshot has invalid session");
+        }
+    }
+    for(uint64_t i = 0; i < header.player_count; ++i) {
+        const FlatPlayer& player = arrays.players[i];
+        check_string(player.name);
+        check_string(player.token);
+        if(!IsRangeValid(player.first_bag_loot, player.bag_size, header.loot_count)) {
+            throw std::runtime_error("Flat snapshot has invalid bag");
+        }
+    }
+}
+
+void FlatSnapshot::RestoreTo(Game& game) const {
+    const FlatArrays arrays = GetArrays(data_);
+
+    for(uint64_t session_idx = 0; session_idx < arrays.header->session_count; ++session_idx) {
+        const FlatSession& flat_session = arrays.sessions[session_idx];
+        std::shared_ptr<GameSession> session = game.GetGameSession(Map::Id{std::string(arrays.GetString(flat_session.map_id))});
+        session->Reserve(flat_session.player_count, flat_session.loot_count);
+        game.ReservePlayers(session, flat_session.player_count);
+
+        for(uint64_t i = 0; i < flat_session.loot_count; ++i) {
+            LootObject loot_object = RestoreLootObject(arrays.loot[flat_session.first_loot + i]);
+            session->AddLootObject(loot_object);
+        }
+
+        for(uint64_t i = 0; i < flat_session.player_count; ++i) {
+            const FlatPlayer& flat_player = arrays.players[flat_session.first_player + i];
+
+            auto dog = std::make_shared<Dog>(flat_player.id);
+            dog->SetId(flat_player.dog_id);
+            dog->SetIdCounter(flat_player.dog_id_counter);
+            dog->SetPosition({flat_player.x, flat_player.y});
+            dog->SetSpeedValue(flat_player.speed_value);
+            dog->SetSpeed({flat_player.speed_x, flat_player.speed_y});
+            dog->RestoreDirection(static_cast<Direction>(flat_player.direction));
+            dog->SetGatherer({flat_player.gatherer_start_x, flat_player.gatherer_start_y},
+                             {flat_player.gatherer_end_x, flat_player.gatherer_end_y});
+            dog->SetWidth(flat_player.gatherer_width);
+            dog->SetScore(flat_player.score);
+
+            Bag& bag = dog->GetBag();
+            bag.capacity = flat_player.bag_capacity;
+            bag.loot_objects.reserve(flat_player.bag_size);
+            for(uint32_t j = 0; j < flat_player.bag_size; ++j) {
+                bag.AddLoot(std::make_shared<LootObject>(RestoreLootObject(arrays.loot[flat_player.first_bag_loot + j])));
+            }
+
+            Player player(dog, std::string(arrays.GetString(flat_player.name)), flat_player.id);
+            player.SetIdCounter(flat_player.id_counter);
+            player.SetSession(session);
+
+            session->AddDog(dog);
+            game.AddRestoredPlayer(session, player, Token{std::string(arrays.GetString(flat_player.token))});
+        }
+    }
+}
+
+}  // namespace model
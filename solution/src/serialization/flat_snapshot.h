@@ -0,0 +1,32 @@
+#pragma once
+
+#include <ostream>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "model_serialization.h"
+
+namespace model {
+
+// Снимок в формате SnapshotFormat::FLAT:
+// [FlatHeader][сессии][игроки][предметы][таблица строк].
+// Все записи фиксированного размера и выровнены по 8 байт, поэтому
+// восстановление - это один линейный проход по отображённому файлу,
+// без разбора архива и промежуточных Repr-объектов.
+void WriteFlatSnapshot(std::span<const GameSessionReprTmp> game_ses_reprs, std::ostream& out);
+
+// Представление плоского снимка поверх чужого буфера (обычно отображённого
+// файла). Конструктор проверяет размеры массивов и все ссылки на строки,
+// предметы и игроков, так что RestoreTo не может упасть на середине.
+class FlatSnapshot {
+public:
+    explicit FlatSnapshot(std::string_view data);
+
+    void RestoreTo(Game& game) const;
+
+private:
+    std::string_view data_;
+};
+
+}  // namespace model
@@ -1,7 +1,326 @@
 #include "model_serialization.h"
+#include "snapshot_file.h"
+#include "flat_snapshot.h"
 
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/stream.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <sstream>
+#include <thread>
+
+using namespace std::literals;
 
 namespace model {
+
+namespace {
+
+namespace io = boost::iostreams;
+
+void RestorePlayer(model::Game& game, const std::shared_ptr<GameSession>& session, const PlayerReprTmp& player_repr) {
+    std::string player_name = player_repr.GetPlayerName();
+    int player_id = player_repr.GetPlayerId();
+
+    const DogRepr& dog_repr = player_repr.GetDogRepr();
+    model::Dog dog = dog_repr.Restore();
+    std::shared_ptr<model::Dog> dog_ptr = std::make_shared<Dog>(dog);
+
+    model::Player player(dog_ptr, player_name, player_id);
+    player.SetSession(session);
+    // Игрок из журнала действий восстанавливается без счётчиков сессии
+    IdCounters{player_id, dog_repr.GetId(), 0}.Restore();
+
+    std::string token_string = player_repr.GetPlayerToken();
+    const model::Token token{token_string};
+
+    session->AddDog(dog_ptr);
+    game.AddRestoredPlayer(session, player, token);
+}
+
+template <typename T>
+void WriteArchive(const T& value, std::ostream& out, SnapshotFormat format) {
+    switch(format) {
+        case SnapshotFormat::TEXT: {
+            boost::archive::text_oarchive oa{out};
+            oa << value;
+            break;
+        }
+        case SnapshotFormat::BINARY: {
+            boost::archive::binary_oarchive oa{out};
+            oa << value;
+            break;
+        }
+        case SnapshotFormat::FLAT:
+            throw std::invalid_argument("Flat snapshot format is not an archive");
+    }
+}
+
+template <typename T>
+T ReadArchive(std::istream& in, SnapshotFormat format) {
+    T value;
+    switch(format) {
+        case SnapshotFormat::TEXT: {
+            boost::archive::text_iarchive ia{in};
+            ia >> value;
+            break;
+        }
+        case SnapshotFormat::BINARY: {
+            boost::archive::binary_iarchive ia{in};
+            ia >> value;
+            break;
+        }
+        default:
+            throw std::runtime_error("Unknown state file format");
+    }
+    return value;
+}
+
+// Выполняет fn(0) ... fn(count - 1) в пуле options.pool, а если его нет - во
+// временном пуле из options.threads потоков. Первое из брошенных исключений
+// пробрасывается после завершения всех задач.
+void RunParallel(size_t count, const SnapshotOptions& options, const std::function<void(size_t)>& fn) {
+    if(options.pool) {
+        options.pool->Run(count, fn);
+        return;
+    }
+    unsigned threads = options.threads;
+    if(threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    TickPool(static_cast<unsigned>(std::min<size_t>(threads, std::max<size_t>(count, 1)))).Run(count, fn);
+}
+
+// Разжимает data, если они записаны со сжатием (признаки в format_word). Возвращает
+// данные формата format и, если пришлось разжимать, хранит их в buffer.
+std::string_view UnpackPayload(std::string_view data, uint32_t format_word, SnapshotFormat& format, std::string& buffer) {
+    format = static_cast<SnapshotFormat>(format_word & SNAPSHOT_FORMAT_MASK);
+    const uint32_t flags = format_word & ~SNAPSHOT_FORMAT_MASK;
+    if(flags == 0) {
+        return data;
+    }
+    if(flags != SNAPSHOT_ZLIB_FLAG) {
+        throw std::runtime_error("Unknown state file compression");
+    }
+    io::filtering_istream zin;
+    zin.push(io::zlib_decompressor());
+    zin.push(io::array_source(data.data(), data.size()));
+    buffer.assign(std::istreambuf_iterator<char>(zin), {});
+    return buffer;
+}
+
+template <typename T>
+T ReadArchivePayload(const SnapshotPayload& payload) {
+    // Архив читается прямо из отображённого файла, без копии в std::string
+    if(!payload.format) {
+        io::stream<io::array_source> in(payload.data.data(), payload.data.size());
+        std::optional<SnapshotFormat> format = DetectSnapshotFormat(in);
+        if(!format) {
+            throw std::runtime_error("Unknown state file format");
+        }
+        return ReadArchive<T>(in, *format);
+    }
+
+    SnapshotFormat format;
+    std::string buffer;
+    std::string_view data = UnpackPayload(payload.data, *payload.format, format, buffer);
+    io::stream<io::array_source> in(data.data(), data.size());
+    return ReadArchive<T>(in, format);
+}
+
+// write_payload(std::ostream&) пишет данные снимка в out; при включённом сжатии
+// они сжимаются по мере записи, несжатая копия целиком в памяти не собирается.
+// Возвращает значение поля format заголовка.
+template <typename Fn>
+uint32_t EncodePayload(Fn&& write_payload, const SnapshotOptions& options, std::ostream& out) {
+    uint32_t format = static_cast<uint32_t>(options.format);
+    if(options.compression_level > 0) {
+        io::filtering_ostream zout;
+        zout.push(io::zlib_compressor(io::zlib_params(options.compression_level)));
+        zout.push(out);
+        write_payload(zout);
+        zout.reset();
+        format |= SNAPSHOT_ZLIB_FLAG;
+    } else {
+        write_payload(out);
+    }
+    return format;
+}
+
+template <typename Fn>
+SnapshotId WritePayloadFile(Fn&& write_payload, const std::string& filename, const SnapshotOptions& options,
+                            unsigned generations, uint64_t journal_lsn) {
+    std::ostringstream out(std::ios_base::out | std::ios_base::binary);
+    const uint32_t format = EncodePayload(write_payload, options, out);
+    return WriteSnapshotFileAtomically(filename, out.view(), format, generations, journal_lsn);
+}
+
+template <typename T>
+SnapshotId WriteArchiveFile(const T& value, const std::string& filename, const SnapshotOptions& options, unsigned generations, uint64_t journal_lsn) {
+    return WritePayloadFile([&value, &options](std::ostream& out) {
+        WriteArchive(value, out, options.format);
+    }, filename, options, generations, journal_lsn);
+}
+
+// Применяет дельта-снимки полного снимка filename по порядку, пока цепочка не прервётся.
+// journal_lsn обновляется номером журнала последней применённой дельты.
+void ApplySnapshotDeltas(model::Game& game, const std::string& filename, SnapshotId base, uint64_t& journal_lsn) {
+    for(unsigned sequence = 1;; ++sequence) {
+        std::string delta_filename = GetSnapshotDeltaName(filename, sequence);
+        if(!std::filesystem::exists(delta_filename)) {
+            return;
+        }
+
+        SnapshotDeltaRepr delta_repr;
+        uint64_t delta_journal_lsn = 0;
+        try {
+            SnapshotPayload payload = ReadSnapshotFilePayload(delta_filename);
+            delta_journal_lsn = payload.journal_lsn;
+            delta_repr = ReadArchivePayload<SnapshotDeltaRepr>(payload);
+        } catch(const std::exception&) {
+            // Остальные дельты опираются на повреждённую, применять их нельзя
+            return;
+        }
+        if(delta_repr.GetBase() != base || delta_repr.GetSequence() != sequence) {
+            // Дельта осталась от предыдущего полного снимка
+            return;
+        }
+
+        for(const auto& session_delta : delta_repr.GetSessions()) {
+            ApplySessionDelta(game, session_delta);
+        }
+        journal_lsn = delta_journal_lsn;
+    }
+}
+
+struct EncodedBlock {
+    std::string data;
+    uint32_t format = 0;
+};
+
+EncodedBlock EncodeSessionBlock(const GameSessionReprTmp& session_repr, const SnapshotOptions& options) {
+    std::ostringstream out(std::ios_base::out | std::ios_base::binary);
+    EncodedBlock block;
+    block.format = EncodePayload([&session_repr, &options](std::ostream& block_out) {
+        if(options.format == SnapshotFormat::FLAT) {
+            WriteFlatSnapshot(std::span(&session_repr, 1), block_out);
+        } else {
+            WriteArchive(session_repr, block_out, options.format);
+        }
+    }, options, out);
+    block.data = std::move(out).str();
+    return block;
+}
+
+// Кодирует сессии в независимые блоки параллельно и пишет их после индекса
+SnapshotId WriteSessionBlocksFile(const std::vector<GameSessionReprTmp>& game_ses_reprs, const std::string& filename,
+                                  const SnapshotOptions& options, uint64_t journal_lsn) {
+    std::vector<EncodedBlock> blocks(game_ses_reprs.size());
+    RunParallel(blocks.size(), options, [&](size_t i) {
+        blocks[i] = EncodeSessionBlock(game_ses_reprs[i], options);
+    });
+
+    constexpr char padding[alignof(uint64_t)] = {};
+    const SnapshotBlockIndex index{blocks.size()};
+    std::vector<SnapshotBlockEntry> entries(blocks.size());
+    uint64_t offset = sizeof(index) + sizeof(SnapshotBlockEntry) * entries.size();
+    std::vector<std::string_view> parts;
+    parts.reserve(2 + blocks.size() * 2);
+    parts.emplace_back(reinterpret_cast<const char*>(&index), sizeof(index));
+    parts.emplace_back(reinterpret_cast<const char*>(entries.data()), sizeof(SnapshotBlockEntry) * entries.size());
+    for(size_t i = 0; i < blocks.size(); ++i) {
+        entries[i] = {offset, blocks[i].data.size(), blocks[i].format, 0};
+        parts.emplace_back(blocks[i].data);
+        offset += blocks[i].data.size();
+        if(const size_t tail = offset % sizeof(padding)) {
+            parts.emplace_back(padding, sizeof(padding) - tail);
+            offset += sizeof(padding) - tail;
+        }
+    }
+    return WriteSnapshotFileAtomically(filename, parts, static_cast<uint32_t>(options.format) | SNAPSHOT_BLOCKS_FLAG,
+                                       options.generations, journal_lsn);
+}
+
+// Разобранная часть снимка, готовая к переносу в игру
+struct DecodedBlock {
+    // Разжатые данные, на которые ссылается flat
+    std::string buffer;
+    std::optional<FlatSnapshot> flat;
+    std::vector<GameSessionReprTmp> session_reprs;
+
+    void RestoreTo(model::Game& game) const {
+        if(flat) {
+            flat->RestoreTo(game);
+        }
+        for(const auto& session_repr : session_reprs) {
+            RestoreSession(game, session_repr);
+        }
+    }
+};
+
+void DecodeBlock(std::string_view data, uint32_t format_word, DecodedBlock& block) {
+    SnapshotFormat format;
+    std::string_view unpacked = UnpackPayload(data, format_word, format, block.buffer);
+    if(format == SnapshotFormat::FLAT) {
+        block.flat.emplace(unpacked);
+        return;
+    }
+    io::stream<io::array_source> in(unpacked.data(), unpacked.size());
+    block.session_reprs.push_back(ReadArchive<GameSessionReprTmp>(in, format));
+}
+
+// Разбирает снимок, не трогая игру; блоки сессий разбираются параллельно.
+// Блоки не перемещаются после разбора: flat ссылается на их buffer.
+std::vector<DecodedBlock> DecodeSnapshotPayload(const SnapshotPayload& payload, const SnapshotOptions& options) {
+    if(!payload.format || !(*payload.format & SNAPSHOT_BLOCKS_FLAG)) {
+        // Весь снимок одним архивом или одним плоским образом
+        std::vector<DecodedBlock> blocks(1);
+        if(payload.format && (*payload.format & SNAPSHOT_FORMAT_MASK) == static_cast<uint32_t>(SnapshotFormat::FLAT)) {
+            SnapshotFormat format;
+            blocks[0].flat.emplace(UnpackPayload(payload.data, *payload.format, format, blocks[0].buffer));
+        } else {
+            blocks[0].session_reprs = ReadArchivePayload<std::vector<GameSessionReprTmp>>(payload);
+        }
+        return blocks;
+    }
+
+    const std::string_view data = payload.data;
+    SnapshotBlockIndex index;
+    if(data.size() < sizeof(index)) {
+        throw SnapshotCorrupted("State file block index is truncated");
+    }
+    std::memcpy(&index, data.data(), sizeof(index));
+    if(index.block_count > (data.size() - sizeof(index)) / sizeof(SnapshotBlockEntry)) {
+        throw SnapshotCorrupted("State file block index is truncated");
+    }
+    std::vector<SnapshotBlockEntry> entries(index.block_count);
+    std::memcpy(entries.data(), data.data() + sizeof(index), sizeof(SnapshotBlockEntry) * entries.size());
+    for(const auto& entry : entries) {
+        if(entry.offset > data.size() || entry.size > data.size() - entry.offset) {
+            throw SnapshotCorrupted("State file has invalid block");
+        }
+    }
+
+    std::vector<DecodedBlock> blocks(entries.size());
+    RunParallel(blocks.size(), options, [&](size_t i) {
+        DecodeBlock(data.substr(entries[i].offset, entries[i].size), entries[i].format, blocks[i]);
+    });
+    return blocks;
+}
+
+}  // namespace
+
+void RestorePlayer(model::Game& game, const std::string& map_id, const PlayerReprTmp& player_repr) {
+    RestorePlayer(game, game.GetGameSession(Map::Id{map_id}), player_repr);
+}
+
 void RestoreSession(model::Game& game, const GameSessionReprTmp& session_repr) {
     std::string map_id_string = session_repr.GetMapIdString();
     const std::vector<PlayerReprTmp>& player_reprs = session_repr.GetPlayerRepr();
@@ -16,24 +335,32 @@ void RestoreSession(model::Game& game, const GameSessionReprTmp& session_repr) {
     }
 
     for(const auto& player_repr : player_reprs) {
-        std::string player_name = player_repr.GetPlayerName();
-        int player_id = player_repr.GetPlayerId();
-        int id_counter_player = player_repr.GetIdCounter();
-
-        const DogRepr& dog_repr = player_repr.GetDogRepr();
-        model::Dog dog = dog_repr.Restore();
-        std::shared_ptr<model::Dog> dog_ptr = std::make_shared<Dog>(dog);
+        RestorePlayer(game, curr_session, player_repr);
+    }
+    session_repr.GetIdCounters().Restore();
+}
 
-        model::Player player(dog_ptr, player_name, player_id);
-        player.SetIdCounter(id_counter_player);
-        player.SetSession(curr_session);
+void ApplySessionDelta(model::Game& game, const GameSessionDeltaRepr& delta_repr) {
+    const Map::Id map_id{delta_repr.GetMapIdString()};
+    std::shared_ptr<GameSession> curr_session = game.GetGameSession(map_id);
 
-        std::string token_string = player_repr.GetPlayerToken();
-        const model::Token token{token_string};
+    for(int loot_id : delta_repr.GetRemovedLootIds()) {
+        curr_session->RemoveLootObject(loot_id);
+    }
+    for(const auto& loot_objerc_repr : delta_repr.GetLootsObjectRepr()) {
+        model::LootObject loot_object = loot_objerc_repr.Restore();
+        curr_session->AddLootObject(loot_object);
+    }
 
-        curr_session->AddDog(dog_ptr);
-        game.AddRestoredPlayer(curr_session, player, token);
+    for(const auto& player_repr : delta_repr.GetPlayerRepr()) {
+        std::shared_ptr<const Player> player = game.FindPlayer(model::Token{player_repr.GetPlayerToken()});
+        if(player) {
+            player_repr.GetDogRepr().RestoreTo(*player->GetDog());
+        } else {
+            RestorePlayer(game, curr_session, player_repr);
+        }
     }
+    delta_repr.GetIdCounters().Restore();
 }
 
 void Restore(model::Game& game) {
@@ -66,43 +393,204 @@ void Save(model::Game& game) {
 }
 
 
-void Restore(model::Game& game, std::string filename) {
-    std::fstream in_fstream;
-    in_fstream.open(filename, std::ios_base::in);
+std::vector<GameSessionReprTmp> CollectSessionReprs(const model::Game& game) {
+    std::vector<GameSessionReprTmp> game_ses_reprs;
+
+    const std::unordered_map<std::shared_ptr<GameSession>, PlayerTokens>& sessions = game.GetSessions();
+    game_ses_reprs.reserve(sessions.size());
+    for(auto& [session_ptr, players_tokens] : sessions) {
+        game_ses_reprs.emplace_back(*session_ptr, players_tokens);
+    }
+    return game_ses_reprs;
+}
+
+SnapshotFormat ParseSnapshotFormat(std::string_view name) {
+    if(name == "text"sv) {
+        return SnapshotFormat::TEXT;
+    }
+    if(name == "binary"sv) {
+        return SnapshotFormat::BINARY;
+    }
+    if(name == "flat"sv) {
+        return SnapshotFormat::FLAT;
+    }
+    throw std::invalid_argument("Unknown state file format: "s + std::string(name));
+}
+
+std::optional<SnapshotFormat> DetectSnapshotFormat(std::istream& in) {
+    // Оба архива начинаются с сигнатуры "serialization::archive":
+    // текстовый - с её длины, записанной десятичными цифрами, бинарный - с длины
+    // в виде size_t. Смотрим на заголовок и возвращаем поток в исходное положение.
+    constexpr std::string_view signature = "serialization::archive"sv;
+    constexpr size_t header_size = sizeof(std::size_t) + signature.size();
+
+    const auto start = in.tellg();
+    std::string header(header_size, '\0');
+    in.read(header.data(), header.size());
+    header.resize(in.gcount());
+    in.clear();
+    in.seekg(start);
+
+    size_t digits = 0;
+    while(digits < header.size() && std::isdigit(static_cast<unsigned char>(header[digits]))) {
+        ++digits;
+    }
+    if(digits > 0 && header.compare(digits, 1 + signature.size(), " "s + std::string(signature)) == 0) {
+        return SnapshotFormat::TEXT;
+    }
+    if(header.size() == header_size && header.compare(sizeof(std::size_t), signature.size(), signature) == 0) {
+        return SnapshotFormat::BINARY;
+    }
+    return std::nullopt;
+}
 
-    if(!in_fstream.is_open()) {
+void WriteSnapshot(const std::vector<GameSessionReprTmp>& game_ses_reprs, std::ostream& out, SnapshotFormat format) {
+    if(format == SnapshotFormat::FLAT) {
+        WriteFlatSnapshot(game_ses_reprs, out);
         return;
     }
+    WriteArchive(game_ses_reprs, out, format);
+}
 
-    boost::archive::text_iarchive ia{in_fstream};
+std::vector<GameSessionReprTmp> ReadSnapshot(std::istream& in) {
+    std::optional<SnapshotFormat> format = DetectSnapshotFormat(in);
+    if(!format) {
+        throw std::runtime_error("Unknown state file format");
+    }
+    return ReadSnapshot(in, *format);
+}
 
-    std::vector<GameSessionReprTmp> game_ses_reprs;
-    ia >> game_ses_reprs;
-    in_fstream.close();
+std::vector<GameSessionReprTmp> ReadSnapshot(std::istream& in, SnapshotFormat format) {
+    return ReadArchive<std::vector<GameSessionReprTmp>>(in, format);
+}
 
-    for(auto session_repr : game_ses_reprs) {
-        RestoreSession(game, session_repr);
+PinnedGameState::PinnedGameState(const model::Game& game)
+    : id_counters_(IdCounters::Current()) {
+    const std::unordered_map<std::shared_ptr<GameSession>, PlayerTokens>& sessions = game.GetSessions();
+    sessions_.reserve(sessions.size());
+    for(const auto& [session_ptr, players_tokens] : sessions) {
+        std::shared_ptr<const PlayerTokens::PlayerLog> players = players_tokens.GetPlayerLog();
+        std::shared_ptr<const GameSession::LootLog> loot_objects = session_ptr->GetLootLog();
+        const size_t players_count = players->Size();
+        const size_t loot_objects_count = loot_objects->Size();
+        sessions_.push_back({*session_ptr->GetMap()->GetId(), std::move(players), players_count,
+                             std::move(loot_objects), loot_objects_count});
     }
 }
 
-void Save(model::Game& game, std::string filename) {
+std::vector<GameSessionReprTmp> PinnedGameState::CollectSessionReprs() const {
+    const uint64_t epoch = GetEpoch();
     std::vector<GameSessionReprTmp> game_ses_reprs;
+    game_ses_reprs.reserve(sessions_.size());
+    for(const PinnedSession& session : sessions_) {
+        std::vector<PlayerReprTmp> player_reprs;
+        player_reprs.reserve(session.players_count);
+        for(size_t i = 0; i < session.players_count; ++i) {
+            const PlayerTokens::PlayerLog::Entry& entry = (*session.players)[i];
+            if(!entry.IsVisibleAt(epoch)) {
+                continue;
+            }
+            const auto& [token, player_ptr] = *entry.value;
+            const Dog& dog = *player_ptr->GetDog();
+            player_reprs.emplace_back(*player_ptr, token, DogRepr(dog, dog.GetState(epoch)));
+        }
 
-    const std::unordered_map<std::shared_ptr<GameSession>, PlayerTokens>& sessions = game.GetSessions();
-    for(auto& [session_ptr, players_tokens] : sessions) {
-        GameSessionReprTmp session_repr(*session_ptr, players_tokens);
-        game_ses_reprs.push_back(session_repr);
+        std::vector<LootObjectRepr> loot_reprs;
+        loot_reprs.reserve(session.loot_objects_count);
+        for(size_t i = 0; i < session.loot_objects_count; ++i) {
+            const GameSession::LootLog::Entry& entry = (*session.loot_objects)[i];
+            if(entry.IsVisibleAt(epoch)) {
+                loot_reprs.emplace_back(**entry.value);
+            }
+        }
+        game_ses_reprs.emplace_back(session.map_id, std::move(player_reprs), std::move(loot_reprs), id_counters_);
     }
+    return game_ses_reprs;
+}
 
-    std::fstream out_fstream;
-    out_fstream.open(filename, std::ios_base::out);
+void ClearDirtyState(model::Game& game) {
+    ClearDirtyState(game, StateEpoch::Advance());
+}
 
-    if(!out_fstream.is_open()) {
-        return;
+void ClearDirtyState(model::Game& game, uint64_t epoch) {
+    game.SetSnapshotEpoch(epoch);
+    for(const auto& [session_ptr, players_tokens] : game.GetSessions()) {
+        session_ptr->ClearDirty();
     }
+}
 
-    boost::archive::text_oarchive oa{out_fstream};
-    oa << game_ses_reprs;
-    out_fstream.close();
+std::vector<GameSessionDeltaRepr> CollectSessionDeltaReprs(model::Game& game) {
+    const uint64_t since_epoch = game.GetSnapshotEpoch();
+    std::vector<GameSessionDeltaRepr> delta_reprs;
+    for(const auto& [session_ptr, players_tokens] : game.GetSessions()) {
+        GameSessionDeltaRepr delta_repr(*session_ptr, players_tokens, since_epoch);
+        if(!delta_repr.IsEmpty()) {
+            delta_reprs.push_back(std::move(delta_repr));
+        }
+    }
+    game.SetSnapshotEpoch(StateEpoch::Advance());
+    return delta_reprs;
+}
+
+std::optional<RestoredSnapshot> Restore(model::Game& game, std::string filename, const SnapshotOptions& options) {
+    std::optional<std::runtime_error> last_error;
+
+    for(unsigned generation = 0; generation <= options.generations; ++generation) {
+        std::string generation_filename = GetSnapshotGenerationName(filename, generation);
+        if(!std::filesystem::exists(generation_filename)) {
+            continue;
+        }
+
+        SnapshotPayload payload;
+        std::vector<DecodedBlock> blocks;
+        try {
+            payload = ReadSnapshotFilePayload(generation_filename);
+            blocks = DecodeSnapshotPayload(payload, options);
+        } catch(const std::exception& ex) {
+            // Пробуем более старое поколение
+            last_error.emplace(ex.what());
+            continue;
+        }
+
+        // Разобранные блоки переносятся в игру по очереди
+        for(const auto& block : blocks) {
+            block.RestoreTo(game);
+        }
+        const SnapshotId snapshot_id = payload.id;
+        uint64_t journal_lsn = payload.journal_lsn;
+        if(generation == 0) {
+            // Дельты есть только у последнего полного снимка:
+            // при записи нового полного снимка они удаляются
+            ApplySnapshotDeltas(game, filename, snapshot_id, journal_lsn);
+        }
+        return RestoredSnapshot{generation_filename, journal_lsn};
+    }
+
+    if(last_error) {
+        throw *last_error;
+    }
+    return std::nullopt;
+}
+
+void Save(model::Game& game, std::string filename, const SnapshotOptions& options, uint64_t journal_lsn) {
+    WriteSnapshotFile(CollectSessionReprs(game), filename, options, journal_lsn);
+}
+
+SnapshotId WriteSnapshotFile(const std::vector<GameSessionReprTmp>& game_ses_reprs, const std::string& filename,
+                             const SnapshotOptions& options, uint64_t journal_lsn) {
+    const SnapshotId id = WriteSessionBlocksFile(game_ses_reprs, filename, options, journal_lsn);
+    RemoveSnapshotDeltas(filename);
+    return id;
+}
+
+void WriteSnapshotDeltaFile(const std::vector<GameSessionDeltaRepr>& delta_reprs, const std::string& filename,
+                            SnapshotId base, unsigned sequence, const SnapshotOptions& options, uint64_t journal_lsn) {
+    SnapshotDeltaRepr delta_repr(base, sequence, delta_reprs);
+    SnapshotOptions delta_options = options;
+    if(delta_options.format == SnapshotFormat::FLAT) {
+        // Дельты маленькие и разбираются архивом, плоский формат только для полных снимков
+        delta_options.format = SnapshotFormat::BINARY;
+    }
+    WriteArchiveFile(delta_repr, GetSnapshotDeltaName(filename, sequence), delta_options, 0, journal_lsn);
 }
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include <boost/serialization/base_object.hpp>
 #include <boost/serialization/vector.hpp>
 #include <boost/serialization/shared_ptr.hpp>
+#include <boost/serialization/version.hpp>
 
 #include "../domain_model/geom.h"
 #include "../domain_model/model_env.h"
@@ -17,7 +18,14 @@
 #include "../application_model/player_tokens.h"
 
 #include "../application_model/game.h"
+#include "../domain_model/tick_pool.h"
+#include "snapshot_file.h"
+#include <algorithm>
 #include <fstream>
+#include <istream>
+#include <optional>
+#include <ostream>
+#include <string_view>
 
 namespace geom {
 
@@ -92,6 +100,49 @@ namespace model{
 
 
 
+// Версии схемы снимка. Версия класса пишется в архив при первом объекте
+// этого класса (BOOST_CLASS_VERSION в конце файла), а serialize при чтении
+// получает версию из файла. Поля, которых в старой версии не было, заполняет
+// Migrate, поэтому снимки, записанные прошлыми версиями сервера,
+// восстанавливаются без холодного старта. Снимки каждой прошлой версии лежат
+// в tests/snapshots и читаются тестами.
+//
+// Версия 1: счётчики идентификаторов хранятся один раз в сессии (IdCounters),
+// а не в каждом игроке, собаке и предмете.
+namespace schema {
+constexpr unsigned LOOT_OBJECT_VERSION = 1;
+constexpr unsigned DOG_VERSION = 1;
+constexpr unsigned PLAYER_VERSION = 1;
+constexpr unsigned GAME_SESSION_VERSION = 1;
+constexpr unsigned GAME_SESSION_DELTA_VERSION = 1;
+}  // namespace schema
+
+// Счётчики идентификаторов игроков, собак и предметов на момент снимка
+struct IdCounters {
+    int player = 0;
+    int dog = 0;
+    int loot_object = 0;
+
+    [[nodiscard]] static IdCounters Current() {
+        return {model::Player::GetIdCounter(), model::Dog::GetIdCounter(), model::LootObject::GetIdCounter()};
+    }
+
+    // Новые объекты не должны получить уже выданные идентификаторы,
+    // поэтому счётчики только увеличиваются
+    void Restore() const {
+        model::Player::SetIdCounter(std::max(model::Player::GetIdCounter(), player));
+        model::Dog::SetIdCounter(std::max(model::Dog::GetIdCounter(), dog));
+        model::LootObject::SetIdCounter(std::max(model::LootObject::GetIdCounter(), loot_object));
+    }
+
+    template <typename Archive>
+    void serialize(Archive& ar, [[maybe_unused]] const unsigned version) {
+        ar& player;
+        ar& dog;
+        ar& loot_object;
+    }
+};
+
 class LootObjectRepr {
 public:
     LootObjectRepr() = default;
@@ -100,24 +151,41 @@ public:
         : item_(loot_object.GetPosition(), loot_object.GetWidth())
         , id_(loot_object.GetId())
         , type_(loot_object.GetType())
-        , value_(loot_object.GetValue())
-        , id_counter_(loot_object.GetIdCounter()) {
+        , value_(loot_object.GetValue()) {
     }
 
     [[nodiscard]] model::LootObject Restore() const {
         model::LootObject loot_object(type_, value_, item_.position, item_.width);
         loot_object.SetId(id_);
-        loot_object.SetIdCounter(id_counter_);
         return loot_object;
     }
 
+    [[nodiscard]] const collision_detector::Item& GetItem() const {
+        return item_;
+    }
+    [[nodiscard]] int GetId() const {
+        return id_;
+    }
+    [[nodiscard]] int GetType() const {
+        return type_;
+    }
+    [[nodiscard]] int GetValue() const {
+        return value_;
+    }
+    // Счётчик предметов из снимка версии 0 (0 в новых снимках)
+    [[nodiscard]] int GetLegacyIdCounter() const {
+        return legacy_id_counter_;
+    }
+
     template <typename Archive>
-    void serialize(Archive& ar, [[maybe_unused]] const unsigned version) {
+    void serialize(Archive& ar, const unsigned version) {
         ar& item_;
         ar& id_;
         ar& type_;
         ar& value_;
-        ar& id_counter_;
+        if(version < 1) {
+            ar& legacy_id_counter_;
+        }
     }
 
 private:
@@ -125,7 +193,7 @@ private:
     int id_;
     int type_ = 0;
     int value_ = 0;
-    int id_counter_;
+    int legacy_id_counter_ = 0;
 };
 
 class BagRepr {
@@ -149,6 +217,20 @@ public:
         return bag;
     }
 
+    [[nodiscard]] int GetCapacity() const {
+        return capacity_;
+    }
+    [[nodiscard]] const std::vector<LootObjectRepr>& GetLootObjectsRepr() const {
+        return loot_objects_repr_;
+    }
+    [[nodiscard]] int GetLegacyIdCounter() const {
+        int id_counter = 0;
+        for(const auto& loot_object_repr : loot_objects_repr_) {
+            id_counter = std::max(id_counter, loot_object_repr.GetLegacyIdCounter());
+        }
+        return id_counter;
+    }
+
     template <typename Archive>
     void serialize(Archive& ar, [[maybe_unused]] const unsigned version) {
         ar& capacity_;
@@ -171,39 +253,77 @@ public:
     DogRepr() = default;
 
     explicit DogRepr(const model::Dog& dog)
-        : id_(dog.GetId())
-        , id_counter_(dog.GetIdCounter())
-        , position_(model::PointDouble{dog.GetPosition().x, dog.GetPosition().y})
-        , speed_(model::PointDouble{dog.GetSpeed().x, dog.GetSpeed().y})
-        , direction_(dog.GetDirectionEnum())
-        , speed_value_(dog.GetSpeedValue())
-        , bag_repr_(dog.GetBag())
-        , score_(dog.GetScore())
-        , gatherer_(collision_detector::Gatherer(dog.start_pos, dog.end_pos, dog.width)){
+        : DogRepr(dog, dog.GetState()) {
+    }
 
+    // state - версия состояния собаки
+    DogRepr(const model::Dog& dog, const model::DogState& state)
+        : id_(dog.GetId())
+        , position_(state.position)
+        , speed_(state.speed)
+        , direction_(state.direction)
+        , speed_value_(state.speed_value)
+        , bag_repr_(state.bag)
+        , score_(state.score)
+        , gatherer_(state.gatherer) {
     }
 
     [[nodiscard]] model::Dog Restore() const {
         model::Dog dog(id_);
+        RestoreTo(dog);
+        return dog;
+    }
+
+    // Переносит сохранённое состояние в уже существующую собаку
+    void RestoreTo(model::Dog& dog) const {
         dog.SetId(id_);
-        dog.SetIdCounter(id_counter_);
         dog.SetPosition(position_);
         dog.SetSpeedValue(speed_value_);
         dog.SetSpeed(speed_);
-        dog.SetDirection(direction_);
+        dog.RestoreDirection(direction_);
         dog.SetGatherer(gatherer_.start_pos, gatherer_.end_pos);
         dog.SetWidth(gatherer_.width);
+        dog.SetScore(score_);
         
         Bag bag = bag_repr_.Restore();
         dog.SetBag(bag);
+    }
 
-        return dog;
+    [[nodiscard]] int GetId() const {
+        return id_;
+    }
+    // Счётчик собак из снимка версии 0 (0 в новых снимках)
+    [[nodiscard]] int GetLegacyIdCounter() const {
+        return legacy_id_counter_;
+    }
+    [[nodiscard]] PointDouble GetPosition() const {
+        return position_;
+    }
+    [[nodiscard]] PointDouble GetSpeed() const {
+        return speed_;
+    }
+    [[nodiscard]] Direction GetDirection() const {
+        return direction_;
+    }
+    [[nodiscard]] double GetSpeedValue() const {
+        return speed_value_;
+    }
+    [[nodiscard]] const BagRepr& GetBagRepr() const {
+        return bag_repr_;
+    }
+    [[nodiscard]] int GetScore() const {
+        return score_;
+    }
+    [[nodiscard]] const collision_detector::Gatherer& GetGatherer() const {
+        return gatherer_;
     }
 
     template <typename Archive>
-    void serialize(Archive& ar, [[maybe_unused]] const unsigned version) {
+    void serialize(Archive& ar, const unsigned version) {
         ar& id_;
-        ar& id_counter_;
+        if(version < 1) {
+            ar& legacy_id_counter_;
+        }
         ar& position_;
         ar& speed_;
         ar& direction_;
@@ -215,7 +335,7 @@ public:
 
 private:
     int id_;
-    int id_counter_;
+    int legacy_id_counter_ = 0;
 
     PointDouble position_;
     PointDouble speed_;
@@ -320,11 +440,14 @@ public:
     PlayerReprTmp() = default;
 
     explicit PlayerReprTmp(const model::Player& player, Token token)
+        : PlayerReprTmp(player, std::move(token), DogRepr(*player.GetDog())) {
+    }
+
+    PlayerReprTmp(const model::Player& player, Token token, DogRepr dog_repr)
         : name_(player.GetName())
         , id_(player.GetId())
-        , dog_repr_(*player.GetDog())    
-        , id_counter_(player.GetIdCounter())
-        , token_(*token){
+        , dog_repr_(std::move(dog_repr))
+        , token_(std::move(*token)) {
     }
 
     [[nodiscard]] std::string GetPlayerName() const {
@@ -336,19 +459,22 @@ public:
     [[nodiscard]] const DogRepr& GetDogRepr() const {
         return dog_repr_;
     }
-    [[nodiscard]] int GetIdCounter() const {
-        return id_counter_;
+    // Счётчик игроков из снимка версии 0 (0 в новых снимках)
+    [[nodiscard]] int GetLegacyIdCounter() const {
+        return legacy_id_counter_;
     }
     [[nodiscard]] std::string GetPlayerToken() const {
         return token_;
     }
 
     template <typename Archive>
-    void serialize(Archive& ar, [[maybe_unused]] const unsigned version) {
+    void serialize(Archive& ar, const unsigned version) {
         ar& name_;
         ar& id_;
         ar& dog_repr_;
-        ar& id_counter_;
+        if(version < 1) {
+            ar& legacy_id_counter_;
+        }
         ar& token_;
     }
 
@@ -356,16 +482,33 @@ private:
     std::string name_;
     int id_;
     DogRepr dog_repr_;
-    int id_counter_;
+    int legacy_id_counter_ = 0;
     std::string token_;
 };
 
+// Счётчики идентификаторов, которые снимок версии 0 хранил в каждом объекте
+inline IdCounters CollectLegacyIdCounters(const std::vector<PlayerReprTmp>& players_repr,
+                                          const std::vector<LootObjectRepr>& loot_objects_repr) {
+    IdCounters id_counters;
+    for(const auto& player_repr : players_repr) {
+        const DogRepr& dog_repr = player_repr.GetDogRepr();
+        id_counters.player = std::max(id_counters.player, player_repr.GetLegacyIdCounter());
+        id_counters.dog = std::max(id_counters.dog, dog_repr.GetLegacyIdCounter());
+        id_counters.loot_object = std::max(id_counters.loot_object, dog_repr.GetBagRepr().GetLegacyIdCounter());
+    }
+    for(const auto& loot_object_repr : loot_objects_repr) {
+        id_counters.loot_object = std::max(id_counters.loot_object, loot_object_repr.GetLegacyIdCounter());
+    }
+    return id_counters;
+}
+
 class GameSessionReprTmp {
 public:
     GameSessionReprTmp() = default;
 
     explicit GameSessionReprTmp(const model::GameSession& game_session, const PlayerTokens& player_tokens)
-        : map_id_str_(*game_session.GetMap()->GetId()) {
+        : map_id_str_(*game_session.GetMap()->GetId())
+        , id_counters_(IdCounters::Current()) {
 
         for(auto [token, player_ptr] : player_tokens.GetTokenToPlayerMap()) {
             PlayerReprTmp player_repr(*player_ptr, token);
@@ -377,6 +520,14 @@ public:
         }
     }
 
+    GameSessionReprTmp(std::string map_id_str, std::vector<PlayerReprTmp> players_repr, std::vector<LootObjectRepr> loot_objects_repr,
+                       IdCounters id_counters)
+        : map_id_str_(std::move(map_id_str))
+        , players_repr_(std::move(players_repr))
+        , loot_objects_repr_(std::move(loot_objects_repr))
+        , id_counters_(id_counters) {
+    }
+
     [[nodiscard]] std::string GetMapIdString() const {
         return map_id_str_;
     }
@@ -386,27 +537,248 @@ public:
     [[nodiscard]] const std::vector<LootObjectRepr>& GetLootsObjectRepr() const {
         return loot_objects_repr_;
     }
+    [[nodiscard]] const IdCounters& GetIdCounters() const {
+        return id_counters_;
+    }
 
     template <typename Archive>
-    void serialize(Archive& ar, [[maybe_unused]] const unsigned version) {
+    void serialize(Archive& ar, const unsigned version) {
+        ar& map_id_str_;
+        ar& players_repr_;
+        ar& loot_objects_repr_;
+        if(version >= 1) {
+            ar& id_counters_;
+        }
+        if constexpr(Archive::is_loading::value) {
+            Migrate(version);
+        }
+    }
+
+private:
+    std::string map_id_str_;
+    std::vector<PlayerReprTmp> players_repr_;
+    std::vector<LootObjectRepr> loot_objects_repr_;
+    IdCounters id_counters_;
+
+    // Дополняет сессию, прочитанную из снимка версии version, до текущей версии
+    void Migrate(unsigned version) {
+        if(version < 1) {
+            id_counters_ = CollectLegacyIdCounters(players_repr_, loot_objects_repr_);
+        }
+    }
+};
+
+// Изменения одной сессии с момента предыдущего снимка: изменившиеся и новые
+// игроки, появившиеся и подобранные предметы
+class GameSessionDeltaRepr {
+public:
+    GameSessionDeltaRepr() = default;
+
+    // Собирает изменения сессии после эпохи since_epoch и сбрасывает
+    // список подобранных предметов сессии
+    GameSessionDeltaRepr(model::GameSession& game_session, const PlayerTokens& player_tokens, uint64_t since_epoch)
+        : map_id_str_(*game_session.GetMap()->GetId())
+        , removed_loot_ids_(game_session.GetRemovedLootIds())
+        , id_counters_(IdCounters::Current()) {
+
+        for(const auto& [token, player_ptr] : player_tokens.GetTokenToPlayerMap()) {
+            if(player_ptr->GetDog()->IsModifiedAfter(since_epoch)) {
+                players_repr_.emplace_back(*player_ptr, token);
+            }
+        }
+        for(const auto& [id, loot_object_ptr] : game_session.GetLootObjects()) {
+            if(loot_object_ptr->IsCreatedAfter(since_epoch)) {
+                loot_objects_repr_.emplace_back(*loot_object_ptr);
+            }
+        }
+        game_session.ClearDirty();
+    }
+
+    [[nodiscard]] bool IsEmpty() const {
+        return players_repr_.empty() && loot_objects_repr_.empty() && removed_loot_ids_.empty();
+    }
+    [[nodiscard]] std::string GetMapIdString() const {
+        return map_id_str_;
+    }
+    [[nodiscard]] const std::vector<PlayerReprTmp>& GetPlayerRepr() const {
+        return players_repr_;
+    }
+    [[nodiscard]] const std::vector<LootObjectRepr>& GetLootsObjectRepr() const {
+        return loot_objects_repr_;
+    }
+    [[nodiscard]] const std::vector<int>& GetRemovedLootIds() const {
+        return removed_loot_ids_;
+    }
+    [[nodiscard]] const IdCounters& GetIdCounters() const {
+        return id_counters_;
+    }
+
+    template <typename Archive>
+    void serialize(Archive& ar, const unsigned version) {
         ar& map_id_str_;
         ar& players_repr_;
         ar& loot_objects_repr_;
+        ar& removed_loot_ids_;
+        if(version >= 1) {
+            ar& id_counters_;
+        }
+        if constexpr(Archive::is_loading::value) {
+            Migrate(version);
+        }
     }
 
 private:
     std::string map_id_str_;
     std::vector<PlayerReprTmp> players_repr_;
     std::vector<LootObjectRepr> loot_objects_repr_;
+    std::vector<int> removed_loot_ids_;
+    IdCounters id_counters_;
+
+    void Migrate(unsigned version) {
+        if(version < 1) {
+            id_counters_ = CollectLegacyIdCounters(players_repr_, loot_objects_repr_);
+        }
+    }
+};
+
+// Дельта-снимок с номером sequence поверх полного снимка base
+class SnapshotDeltaRepr {
+public:
+    SnapshotDeltaRepr() = default;
+
+    SnapshotDeltaRepr(SnapshotId base, unsigned sequence, std::vector<GameSessionDeltaRepr> sessions)
+        : base_crc_(base.crc)
+        , base_size_(base.size)
+        , sequence_(sequence)
+        , sessions_(std::move(sessions)) {
+    }
+
+    [[nodiscard]] SnapshotId GetBase() const {
+        return {base_crc_, base_size_};
+    }
+    [[nodiscard]] unsigned GetSequence() const {
+        return sequence_;
+    }
+    [[nodiscard]] const std::vector<GameSessionDeltaRepr>& GetSessions() const {
+        return sessions_;
+    }
+
+    template <typename Archive>
+    void serialize(Archive& ar, [[maybe_unused]] const unsigned version) {
+        ar& base_crc_;
+        ar& base_size_;
+        ar& sequence_;
+        ar& sessions_;
+    }
+
+private:
+    uint32_t base_crc_ = 0;
+    uint64_t base_size_ = 0;
+    unsigned sequence_ = 0;
+    std::vector<GameSessionDeltaRepr> sessions_;
+};
+
+// Формат архива, в который пишется снимок состояния.
+// BINARY заметно быстрее на больших играх, но переносим только между
+// машинами с одинаковым порядком байтов и размерами типов.
+enum class SnapshotFormat {
+    TEXT,
+    BINARY,
+    // Плоские массивы записей фиксированного размера, которые восстанавливаются
+    // прямо из отображённого в память файла без разбора архива
+    FLAT
+};
+
+struct SnapshotOptions {
+    SnapshotFormat format = SnapshotFormat::TEXT;
+    // Сколько предыдущих поколений файла состояния хранить рядом с ним
+    unsigned generations = 2;
+    // Сколько дельта-снимков записывать между полными (0 - только полные снимки)
+    unsigned delta_count = 0;
+    // Уровень сжатия архива zlib от 1 до 9 (0 - без сжатия)
+    int compression_level = 0;
+    // Сколько потоков кодируют и разбирают блоки сессий полного снимка (0 - по числу ядер)
+    unsigned threads = 0;
+    // Потоки для блоков сессий, живущие между снимками (сервер создаёт пул из threads
+    // потоков один раз). Без пула потоки запускаются на время одного снимка.
+    std::shared_ptr<TickPool> pool = nullptr;
+};
+
+SnapshotFormat ParseSnapshotFormat(std::string_view name);
+// Определяет формат архива по его заголовку, не сдвигая позицию потока
+std::optional<SnapshotFormat> DetectSnapshotFormat(std::istream& in);
+
+std::vector<GameSessionReprTmp> CollectSessionReprs(const model::Game& game);
+
+// Состояние игры, закреплённое на эпохе (см. StateEpoch). Создаётся в потоке,
+// изменяющем игру, за O(числа сессий): запоминает списки игроков и предметов
+// сессий и их длину, не копируя самих объектов. CollectSessionReprs можно
+// вызывать в любом потоке, пока игра продолжает изменяться; результат
+// совпадает с состоянием на момент закрепления. Пока объект жив, первое
+// изменение собаки в каждой новой эпохе копирует её состояние.
+class PinnedGameState {
+public:
+    explicit PinnedGameState(const model::Game& game);
+
+    uint64_t GetEpoch() const noexcept {
+        return pin_.GetEpoch();
+    }
+
+    std::vector<GameSessionReprTmp> CollectSessionReprs() const;
+
+private:
+    struct PinnedSession {
+        std::string map_id;
+        std::shared_ptr<const PlayerTokens::PlayerLog> players;
+        size_t players_count;
+        std::shared_ptr<const GameSession::LootLog> loot_objects;
+        size_t loot_objects_count;
+    };
+
+    EpochPin pin_;
+    IdCounters id_counters_;
+    std::vector<PinnedSession> sessions_;
+};
+
+// Отмечает, что полный снимок снят: следующая дельта соберёт изменения после
+// текущей эпохи (или после закреплённой эпохи epoch)
+void ClearDirtyState(model::Game& game);
+void ClearDirtyState(model::Game& game, uint64_t epoch);
+// Собирает изменения всех сессий с момента предыдущего снимка и начинает отсчёт заново
+std::vector<GameSessionDeltaRepr> CollectSessionDeltaReprs(model::Game& game);
+void WriteSnapshot(const std::vector<GameSessionReprTmp>& game_ses_reprs, std::ostream& out, SnapshotFormat format);
+std::vector<GameSessionReprTmp> ReadSnapshot(std::istream& in);
+std::vector<GameSessionReprTmp> ReadSnapshot(std::istream& in, SnapshotFormat format);
+// Записывает полный снимок и удаляет дельта-снимки предыдущего полного.
+// Каждая сессия кодируется (и сжимается) в отдельный блок параллельно с остальными.
+// journal_lsn - номер первой записи журнала действий, не вошедшей в снимок.
+SnapshotId WriteSnapshotFile(const std::vector<GameSessionReprTmp>& game_ses_reprs, const std::string& filename,
+                             const SnapshotOptions& options, uint64_t journal_lsn = 0);
+void WriteSnapshotDeltaFile(const std::vector<GameSessionDeltaRepr>& delta_reprs, const std::string& filename,
+                            SnapshotId base, unsigned sequence, const SnapshotOptions& options, uint64_t journal_lsn = 0);
+
+struct RestoredSnapshot {
+    std::string filename;
+    // Номер записи журнала действий, с которой нужно продолжить восстановление (0 - журнал не вёлся)
+    uint64_t journal_lsn = 0;
 };
 
 void RestoreSession(model::Game& game, const GameSessionReprTmp& session_repr);
+// Добавляет в сессию карты map_id игрока вместе с его собакой и токеном
+void RestorePlayer(model::Game& game, const std::string& map_id, const PlayerReprTmp& player_repr);
+void ApplySessionDelta(model::Game& game, const GameSessionDeltaRepr& delta_repr);
 void Restore(model::Game& game);
 void Save(model::Game& game);
-void Restore(model::Game& game, std::string filename);
-void Save(model::Game& game, std::string filename);
+// Восстанавливает игру из самого свежего неповреждённого поколения файла состояния.
+// Для последнего поколения дополнительно применяется цепочка его дельта-снимков.
+// Возвращает имя использованного файла или std::nullopt, если файлов состояния нет.
+std::optional<RestoredSnapshot> Restore(model::Game& game, std::string filename, const SnapshotOptions& options = {});
+void Save(model::Game& game, std::string filename, const SnapshotOptions& options = {}, uint64_t journal_lsn = 0);
 
 }
 
-
-
+BOOST_CLASS_VERSION(model::LootObjectRepr, model::schema::LOOT_OBJECT_VERSION)
+BOOST_CLASS_VERSION(model::DogRepr, model::schema::DOG_VERSION)
+BOOST_CLASS_VERSION(model::PlayerReprTmp, model::schema::PLAYER_VERSION)
+BOOST_CLASS_VERSION(model::GameSessionReprTmp, model::schema::GAME_SESSION_VERSION)
+BOOST_CLASS_VERSION(model::GameSessionDeltaRepr, model::schema::GAME_SESSION_DELTA_VERSION)
@@ -0,0 +1,249 @@
+#include "snapshot_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+using namespace std::literals;
+
+namespace model {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+// Заголовок версии 1, без номера записи журнала
+struct SnapshotHeaderV1 {
+    char magic[8];
+    uint32_t version;
+    uint32_t format;
+    uint64_t payload_size;
+    uint32_t payload_crc;
+    uint32_t header_crc;
+};
+
+template <typename Header>
+uint32_t HeaderCrc(const Header& header) {
+    return Crc32(&header, offsetof(Header, header_crc));
+}
+
+[[noreturn]] void ThrowErrno(const std::string& what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+void RotateGenerations(const std::string& filename, unsigned generations) {
+    if (generations == 0 || !fs::exists(filename)) {
+        return;
+    }
+    for (unsigned generation = generations; generation > 1; --generation) {
+        const std::string older = GetSnapshotGenerationName(filename, generation - 1);
+        if (fs::exists(older)) {
+            fs::rename(older, GetSnapshotGenerationName(filename, generation));
+        }
+    }
+    // Жёсткая ссылка, а не переименование: до rename временного файла
+    // по имени filename всё время лежит валидный снимок
+    const std::string previous = GetSnapshotGenerationName(filename, 1);
+    fs::remove(previous);
+    std::error_code ec;
+    fs::create_hard_link(filename, previous, ec);
+    if (ec) {
+        fs::copy_file(filename, previous, fs::copy_options::overwrite_existing);
+    }
+}
+
+}  // namespace
+
+uint32_t Crc32(const void* data, size_t size, uint32_t crc) {
+    if (size == 0) {
+        // crc32_z с нулевым указателем возвращает начальное значение, а не crc
+        return crc;
+    }
+    // Тот же CRC-32, что и boost::crc_32_type, но zlib считает его в разы быстрее
+    return static_cast<uint32_t>(crc32_z(crc, static_cast<const Bytef*>(data), size));
+}
+
+FileDescriptor::FileDescriptor(const std::string& path, int flags, mode_t mode)
+    : fd_(::open(path.c_str(), flags, mode)) {
+    if (fd_ < 0) {
+        ThrowErrno("Failed to open "s + path);
+    }
+}
+
+FileDescriptor::~FileDescriptor() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+void FileDescriptor::WriteAll(const void* data, size_t size) {
+    const char* ptr = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t written = ::write(fd_, ptr, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ThrowErrno("Failed to write file");
+        }
+        ptr += written;
+        size -= static_cast<size_t>(written);
+    }
+}
+
+int FileDescriptor::Get() const {
+    return fd_;
+}
+
+void FileDescriptor::Sync() {
+    if (::fsync(fd_) != 0) {
+        ThrowErrno("Failed to fsync file");
+    }
+}
+
+void FileDescriptor::Close() {
+    int fd = fd_;
+    fd_ = -1;
+    if (::close(fd) != 0) {
+        ThrowErrno("Failed to close file");
+    }
+}
+
+void SyncDirectory(const std::string& file) {
+    fs::path dir = fs::absolute(file).parent_path();
+    FileDescriptor dir_fd(dir.string(), O_RDONLY | O_DIRECTORY);
+    dir_fd.Sync();
+}
+
+std::string GetSnapshotGenerationName(const std::string& filename, unsigned generation) {
+    if (generation == 0) {
+        return filename;
+    }
+    return filename + "." + std::to_string(generation);
+}
+
+std::string GetSnapshotDeltaName(const std::string& filename, unsigned sequence) {
+    return filename + ".delta." + std::to_string(sequence);
+}
+
+void RemoveSnapshotDeltas(const std::string& filename) {
+    for (unsigned sequence = 1; fs::remove(GetSnapshotDeltaName(filename, sequence)); ++sequence) {
+    }
+}
+
+SnapshotId WriteSnapshotFileAtomically(const std::string& filename, std::string_view payload, uint32_t format,
+                                       unsigned generations, uint64_t journal_lsn) {
+    return WriteSnapshotFileAtomically(filename, std::span<const std::string_view>(&payload, 1), format, generations, journal_lsn);
+}
+
+SnapshotId WriteSnapshotFileAtomically(const std::string& filename, std::span<const std::string_view> payload_parts,
+                                       uint32_t format, unsigned generations, uint64_t journal_lsn) {
+    SnapshotHeader header{};
+    std::memcpy(header.magic, SnapshotHeader::MAGIC, sizeof(header.magic));
+    header.version = SnapshotHeader::VERSION;
+    header.format = format;
+    header.journal_lsn = journal_lsn;
+    for (std::string_view part : payload_parts) {
+        header.payload_size += part.size();
+        header.payload_crc = Crc32(part.data(), part.size(), header.payload_crc);
+    }
+    header.header_crc = HeaderCrc(header);
+
+    const std::string tmp_filename = filename + ".tmp";
+    {
+        FileDescriptor out(tmp_filename, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        out.WriteAll(&header, sizeof(header));
+        for (std::string_view part : payload_parts) {
+            out.WriteAll(part.data(), part.size());
+        }
+        out.Sync();
+        out.Close();
+    }
+
+    RotateGenerations(filename, generations);
+    fs::rename(tmp_filename, filename);
+    SyncDirectory(filename);
+
+    return {header.payload_crc, header.payload_size};
+}
+
+MappedFile::MappedFile(const std::string& path) {
+    FileDescriptor file(path, O_RDONLY | O_CLOEXEC);
+    struct stat file_stat{};
+    if (::fstat(file.Get(), &file_stat) != 0) {
+        ThrowErrno("Failed to stat "s + path);
+    }
+    size_ = static_cast<size_t>(file_stat.st_size);
+    if (size_ == 0) {
+        return;
+    }
+    data_ = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, file.Get(), 0);
+    if (data_ == MAP_FAILED) {
+        data_ = nullptr;
+        ThrowErrno("Failed to map "s + path);
+    }
+    // Файл читается один раз от начала до конца
+    ::madvise(data_, size_, MADV_SEQUENTIAL);
+}
+
+MappedFile::~MappedFile() {
+    if (data_) {
+        ::munmap(data_, size_);
+    }
+}
+
+SnapshotPayload ReadSnapshotFilePayload(const std::string& filename) {
+    auto file = std::make_shared<const MappedFile>(filename);
+    const std::string_view bytes = file->GetData();
+
+    const bool has_header = bytes.size() >= sizeof(SnapshotHeaderV1)
+                         && std::memcmp(bytes.data(), SnapshotHeader::MAGIC, sizeof(SnapshotHeader::MAGIC)) == 0;
+
+    if (!has_header) {
+        // Файл старого формата: архив без заголовка, проверить нечего
+        return {std::nullopt, bytes, {Crc32(bytes.data(), bytes.size()), bytes.size()}, 0, std::move(file)};
+    }
+
+    uint32_t version = 0;
+    std::memcpy(&version, bytes.data() + offsetof(SnapshotHeader, version), sizeof(version));
+
+    SnapshotHeader header{};
+    size_t header_size = 0;
+    if (version == 1) {
+        SnapshotHeaderV1 header_v1{};
+        std::memcpy(&header_v1, bytes.data(), sizeof(header_v1));
+        if (header_v1.header_crc != HeaderCrc(header_v1)) {
+            throw SnapshotCorrupted("State file "s + filename + " has corrupted header");
+        }
+        header = {{}, header_v1.version, header_v1.format, header_v1.payload_size, 0, header_v1.payload_crc, 0};
+        header_size = sizeof(header_v1);
+    } else {
+        if (bytes.size() < sizeof(header)) {
+            throw SnapshotCorrupted("State file "s + filename + " is truncated");
+        }
+        std::memcpy(&header, bytes.data(), sizeof(header));
+        if (header.header_crc != HeaderCrc(header) || header.version != SnapshotHeader::VERSION) {
+            throw SnapshotCorrupted("State file "s + filename + " has corrupted header");
+        }
+        header_size = sizeof(header);
+    }
+
+    if (bytes.size() != header_size + header.payload_size) {
+        throw SnapshotCorrupted("State file "s + filename + " is truncated");
+    }
+
+    const std::string_view data = bytes.substr(header_size);
+    if (Crc32(data.data(), data.size()) != header.payload_crc) {
+        throw SnapshotCorrupted("State file "s + filename + " checksum mismatch");
+    }
+    return {header.format, data, {header.payload_crc, header.payload_size}, header.journal_lsn, std::move(file)};
+}
+
+}  // namespace model
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace model {
+
+// Заголовок файла состояния. Пишется перед архивом и позволяет обнаружить
+// обрезанный или повреждённый файл до того, как его начнёт разбирать архив.
+struct SnapshotHeader {
+    static constexpr char MAGIC[8] = {'G', 'S', 'S', 'N', 'A', 'P', '\0', '\1'};
+    static constexpr uint32_t VERSION = 2;
+
+    char magic[8];
+    uint32_t version;
+    // Значение model::SnapshotFormat и признаки сжатия
+    uint32_t format;
+    uint64_t payload_size;
+    // Номер первой записи журнала действий, не вошедшей в снимок (0 - журнал не вёлся).
+    // Появился в версии 2, заголовок версии 1 на 8 байт короче.
+    uint64_t journal_lsn;
+    uint32_t payload_crc;
+    // Контрольная сумма всех предыдущих полей заголовка
+    uint32_t header_crc;
+};
+
+// Младшие 16 бит поля format - значение model::SnapshotFormat,
+// старшие - признаки сжатия архива
+constexpr uint32_t SNAPSHOT_FORMAT_MASK = 0xffff;
+constexpr uint32_t SNAPSHOT_ZLIB_FLAG = 1u << 16;
+// Payload разбит на независимые блоки по сессиям: [SnapshotBlockIndex][блоки].
+// Формат и сжатие каждого блока записаны в его SnapshotBlockEntry.
+constexpr uint32_t SNAPSHOT_BLOCKS_FLAG = 1u << 17;
+
+struct SnapshotBlockIndex {
+    uint64_t block_count;
+};
+
+struct SnapshotBlockEntry {
+    // Смещение от начала payload, кратно 8, чтобы плоские блоки читались прямо из файла
+    uint64_t offset;
+    uint64_t size;
+    // Как поле format заголовка: model::SnapshotFormat и признаки сжатия
+    uint32_t format;
+    uint32_t reserved;
+};
+
+class SnapshotCorrupted : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// Идентифицирует содержимое полного снимка, на который ссылаются дельта-снимки
+struct SnapshotId {
+    uint32_t crc = 0;
+    uint64_t size = 0;
+
+    bool operator==(const SnapshotId&) const = default;
+};
+
+// Файл, отображённый в память только для чтения
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile();
+
+    std::string_view GetData() const {
+        return {static_cast<const char*>(data_), size_};
+    }
+
+private:
+    void* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+struct SnapshotPayload {
+    // std::nullopt для файлов старого формата, записанных без заголовка
+    std::optional<uint32_t> format;
+    // Архив внутри отображённого файла, действителен, пока жив file
+    std::string_view data;
+    SnapshotId id;
+    uint64_t journal_lsn = 0;
+    std::shared_ptr<const MappedFile> file;
+};
+
+// crc - сумма предыдущих данных, если считать по частям
+uint32_t Crc32(const void* data, size_t size, uint32_t crc = 0);
+
+// Владеющая обёртка над POSIX-дескриптором для записи с fsync
+class FileDescriptor {
+public:
+    FileDescriptor(const std::string& path, int flags, mode_t mode = 0);
+
+    FileDescriptor(const FileDescriptor&) = delete;
+    FileDescriptor& operator=(const FileDescriptor&) = delete;
+
+    ~FileDescriptor();
+
+    int Get() const;
+    void WriteAll(const void* data, size_t size);
+    void Sync();
+    void Close();
+
+private:
+    int fd_;
+};
+
+// Сбрасывает на диск каталог, в котором лежит file, чтобы переименования и
+// создание файлов пережили падение системы
+void SyncDirectory(const std::string& file);
+
+// Имя файла поколения generation: 0 - сам файл состояния, 1 - предыдущий снимок и т.д.
+std::string GetSnapshotGenerationName(const std::string& filename, unsigned generation);
+// Имя дельта-снимка с номером sequence (начиная с 1) после полного снимка filename
+std::string GetSnapshotDeltaName(const std::string& filename, unsigned sequence);
+// Удаляет все дельта-снимки, записанные после полного снимка filename
+void RemoveSnapshotDeltas(const std::string& filename);
+
+// Записывает payload во временный файл, сбрасывает его на диск, сдвигает
+// старые поколения (оставляя не больше generations штук) и атомарно
+// переименовывает временный файл в filename.
+SnapshotId WriteSnapshotFileAtomically(const std::string& filename, std::string_view payload, uint32_t format,
+                                       unsigned generations, uint64_t journal_lsn = 0);
+// То же для payload, собранного из нескольких частей, которые пишутся подряд
+SnapshotId WriteSnapshotFileAtomically(const std::string& filename, std::span<const std::string_view> payload_parts,
+                                       uint32_t format, unsigned generations, uint64_t journal_lsn = 0);
+
+// Отображает файл в память и проверяет заголовок и контрольную сумму.
+// Бросает SnapshotCorrupted, если файл повреждён.
+SnapshotPayload ReadSnapshotFilePayload(const std::string& filename);
+
+}  // namespace model
@@ -0,0 +1,99 @@
+#include "snapshot_writer.h"
+
+namespace model {
+
+SnapshotWriter::SnapshotWriter(WrittenHandler on_written, ErrorHandler on_error)
+    : on_written_(std::move(on_written))
+    , on_error_(std::move(on_error))
+    , thread_([this](std::stop_token stop) { Run(stop); }) {
+}
+
+SnapshotWriter::~SnapshotWriter() {
+    Flush();
+    thread_.request_stop();
+}
+
+void SnapshotWriter::Write(std::vector<GameSessionReprTmp> game_ses_reprs, std::string filename, SnapshotOptions options, uint64_t journal_lsn) {
+    {
+        std::lock_guard lock(mutex_);
+        pending_.push_back(Job{std::move(game_ses_reprs), std::move(filename), options, journal_lsn});
+    }
+    job_ready_.notify_one();
+}
+
+void SnapshotWriter::Write(PinnedGameState pinned, std::string filename, SnapshotOptions options, uint64_t journal_lsn) {
+    {
+        std::lock_guard lock(mutex_);
+        pending_.push_back(Job{std::move(pinned), std::move(filename), options, journal_lsn});
+    }
+    job_ready_.notify_one();
+}
+
+void SnapshotWriter::WriteDelta(std::vector<GameSessionDeltaRepr> delta_reprs, unsigned sequence, std::string filename, SnapshotOptions options,
+                                uint64_t journal_lsn) {
+    {
+        std::lock_guard lock(mutex_);
+        pending_.push_back(Job{DeltaJob{std::move(delta_reprs), sequence}, std::move(filename), options, journal_lsn});
+    }
+    job_ready_.notify_one();
+}
+
+void SnapshotWriter::Flush() {
+    std::unique_lock lock(mutex_);
+    idle_.wait(lock, [this] {
+        return pending_.empty() && !busy_;
+    });
+}
+
+void SnapshotWriter::WriteJob(Job& job) {
+    if (const auto* pinned = std::get_if<PinnedGameState>(&job.snapshot)) {
+        // Копия снята, эпоха больше не нужна игре
+        job.snapshot = pinned->CollectSessionReprs();
+    }
+    if (const auto* game_ses_reprs = std::get_if<std::vector<GameSessionReprTmp>>(&job.snapshot)) {
+        last_full_snapshot_.reset();
+        last_full_snapshot_ = WriteSnapshotFile(*game_ses_reprs, job.filename, job.options, job.journal_lsn);
+        return;
+    }
+
+    const DeltaJob& delta_job = std::get<DeltaJob>(job.snapshot);
+    if (!last_full_snapshot_) {
+        throw std::runtime_error("Delta snapshot has no full snapshot to refer to");
+    }
+    WriteSnapshotDeltaFile(delta_job.delta_reprs, job.filename, *last_full_snapshot_, delta_job.sequence, job.options, job.journal_lsn);
+}
+
+void SnapshotWriter::Run(std::stop_token stop) {
+    std::unique_lock lock(mutex_);
+    while (true) {
+        if (!job_ready_.wait(lock, stop, [this] { return !pending_.empty(); })) {
+            return;
+        }
+        Job job = std::move(pending_.front());
+        pending_.pop_front();
+        busy_ = true;
+        lock.unlock();
+
+        const auto start = std::chrono::steady_clock::now();
+        try {
+            WriteJob(job);
+            if (on_written_) {
+                on_written_(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start), job.journal_lsn);
+            }
+        } catch (const std::exception& ex) {
+            // Следующие дельты не к чему применять, пока не будет записан полный снимок
+            last_full_snapshot_.reset();
+            if (on_error_) {
+                on_error_(ex);
+            }
+        }
+
+        lock.lock();
+        busy_ = false;
+        if (pending_.empty()) {
+            idle_.notify_all();
+        }
+    }
+}
+
+}  // namespace model
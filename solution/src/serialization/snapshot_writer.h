@@ -0,0 +1,80 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <variant>
+#include <vector>
+
+#include "model_serialization.h"
+
+namespace model {
+
+// Вторая фаза сохранения: кодирование снимка и запись файла в отдельном потоке.
+// Первая фаза (закрепление PinnedGameState, CollectSessionReprs или
+// CollectSessionDeltaReprs) выполняется в api_strand и передаёт сюда
+// закреплённое состояние или уже готовую копию. Снимки пишутся
+// строго в порядке постановки: дельта-снимок ссылается на последний
+// записанный полный снимок и теряться не должен.
+class SnapshotWriter {
+public:
+    // journal_lsn - номер первой записи журнала действий, не вошедшей в записанный снимок
+    using WrittenHandler = std::function<void(std::chrono::microseconds encode_time, uint64_t journal_lsn)>;
+    using ErrorHandler = std::function<void(const std::exception& ex)>;
+
+    SnapshotWriter(WrittenHandler on_written, ErrorHandler on_error);
+
+    SnapshotWriter(const SnapshotWriter&) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+    // Дописывает ожидающие снимки и останавливает поток
+    ~SnapshotWriter();
+
+    void Write(std::vector<GameSessionReprTmp> game_ses_reprs, std::string filename, SnapshotOptions options, uint64_t journal_lsn = 0);
+    // Состояние собирается из pinned в потоке записи, эпоха освобождается до кодирования
+    void Write(PinnedGameState pinned, std::string filename, SnapshotOptions options, uint64_t journal_lsn = 0);
+    // Если полный снимок, на который должна опираться дельта, не удалось
+    // записать, дельта отбрасывается и вызывается on_error
+    void WriteDelta(std::vector<GameSessionDeltaRepr> delta_reprs, unsigned sequence, std::string filename, SnapshotOptions options,
+                    uint64_t journal_lsn = 0);
+
+    // Блокирует вызывающий поток, пока все поставленные снимки не будут записаны
+    void Flush();
+
+private:
+    struct DeltaJob {
+        std::vector<GameSessionDeltaRepr> delta_reprs;
+        unsigned sequence;
+    };
+
+    struct Job {
+        std::variant<std::vector<GameSessionReprTmp>, PinnedGameState, DeltaJob> snapshot;
+        std::string filename;
+        SnapshotOptions options;
+        uint64_t journal_lsn;
+    };
+
+    void Run(std::stop_token stop);
+    void WriteJob(Job& job);
+
+    WrittenHandler on_written_;
+    ErrorHandler on_error_;
+
+    std::mutex mutex_;
+    std::condition_variable_any job_ready_;
+    std::condition_variable idle_;
+    std::deque<Job> pending_;
+    bool busy_ = false;
+
+    // Используется только потоком записи
+    std::optional<SnapshotId> last_full_snapshot_;
+
+    std::jthread thread_;
+};
+
+}  // namespace model
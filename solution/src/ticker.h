@@ -5,25 +5,121 @@
 #include <boost/asio/strand.hpp>
 #include <boost/beast.hpp>
 
+#include <algorithm>
 #include <chrono>
+#include <cstdint>
+#include <optional>
 
 namespace net = boost::asio;
 namespace sys = boost::system;
 
+// Режим с фиксированным шагом: шаги привязаны к моментам start + k * period
+struct FixedStep {
+    // Сколько шагов можно выполнить за одно пробуждение, догоняя расписание
+    unsigned max_steps = 5;
+    // Шаги сверх max_steps сливаются в последний (время игры не теряется)
+    // или выбрасываются
+    bool merge = true;
+};
+
+struct TickerStats {
+    uint64_t steps = 0;
+    // Пробуждения, к которым прошло больше одного шага расписания
+    uint64_t overruns = 0;
+    // Шаги сверх FixedStep::max_steps, слитые или выброшенные
+    uint64_t skipped_steps = 0;
+    // Опоздание пробуждения относительно расписания: последнее и наибольшее
+    std::chrono::milliseconds lag{0};
+    std::chrono::milliseconds max_lag{0};
+};
+
+// Расписание режима с фиксированным шагом. Время обработчика не копится в
+// дрейф: следующий срок отсчитывается от прошлого срока, а не от конца тика.
+class FixedStepSchedule {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Steps {
+        unsigned count = 0;
+        // Длительность последнего шага вместе со слитыми; остальные - period
+        std::chrono::milliseconds last_delta{0};
+    };
+
+    FixedStepSchedule(std::chrono::milliseconds period, FixedStep options)
+        : period_{period}
+        , options_{options} {
+    }
+
+    void Start(Clock::time_point now) {
+        deadline_ = now + period_;
+    }
+    Clock::time_point GetDeadline() const noexcept {
+        return deadline_;
+    }
+
+    // Шаги, которые пора выполнить в момент now, и следующий срок
+    Steps Advance(Clock::time_point now) {
+        using namespace std::chrono;
+        const auto late = std::max(duration_cast<milliseconds>(now - deadline_), milliseconds{0});
+        const int64_t due = 1 + late / period_;
+        const unsigned count = static_cast<unsigned>(std::min<int64_t>(due, std::max(options_.max_steps, 1u)));
+        const int64_t skipped = due - count;
+
+        deadline_ += due * period_;
+        stats_.steps += count;
+        stats_.overruns += due > 1 ? 1 : 0;
+        stats_.skipped_steps += skipped;
+        stats_.lag = late;
+        stats_.max_lag = std::max(stats_.max_lag, late);
+        return {count, period_ * (1 + (options_.merge ? skipped : 0))};
+    }
+
+    const TickerStats& GetStats() const noexcept {
+        return stats_;
+    }
+    void ResetStats() {
+        stats_ = TickerStats{};
+    }
+
+private:
+    std::chrono::milliseconds period_;
+    FixedStep options_;
+    Clock::time_point deadline_;
+    TickerStats stats_;
+};
+
 class Ticker : public std::enable_shared_from_this<Ticker> {
 public:
     using Strand = net::strand<net::io_context::executor_type>;
     using Handler = std::function<void(std::chrono::milliseconds delta)>;
+    using StatsHandler = std::function<void(const TickerStats& stats)>;
 
-    // Функция handler будет вызываться внутри strand с интервалом period
-    Ticker(Strand strand, std::chrono::milliseconds period, Handler handler)
+    // Счётчики режима с фиксированным шагом отдаются раз в столько шагов
+    static constexpr uint64_t STATS_PERIOD = 1000;
+
+    // Функция handler будет вызываться внутри strand с интервалом period. Без
+    // fixed_step таймер взводится на period после обработчика, и delta - время
+    // с прошлого тика. С fixed_step delta всегда period (кроме слитых шагов).
+    Ticker(Strand strand, std::chrono::milliseconds period, Handler handler,
+           std::optional<FixedStep> fixed_step = std::nullopt)
         : strand_{strand}
         , period_{period}
         , handler_{std::move(handler)} {
+        if (fixed_step) {
+            schedule_.emplace(period_, *fixed_step);
+        }
+    }
+
+    // Вызывается до Start
+    void SetStatsHandler(StatsHandler handler) {
+        stats_handler_ = std::move(handler);
     }
 
     void Start() {
             last_tick_ = Clock::now();
+            if (schedule_) {
+                schedule_->Start(last_tick_);
+            }
             net::dispatch(strand_, [self = shared_from_this()] {
                 self->ScheduleTick();
         });
@@ -32,7 +128,11 @@ public:
 private:
     void ScheduleTick() {
         assert(strand_.running_in_this_thread());
-        timer_.expires_after(period_);
+        if (schedule_) {
+            timer_.expires_at(schedule_->GetDeadline());
+        } else {
+            timer_.expires_after(period_);
+        }
         timer_.async_wait([self = shared_from_this()](sys::error_code ec) {
             self->OnTick(ec);
         });
@@ -43,17 +143,40 @@ private:
         assert(strand_.running_in_this_thread());
 
         if (!ec) {
-            auto this_tick = Clock::now();
-            auto delta = duration_cast<milliseconds>(this_tick - last_tick_);
-            last_tick_ = this_tick;
-            try {
-                handler_(delta);
-            } catch (...) {
+            if (schedule_) {
+                RunSteps();
+            } else {
+                auto this_tick = Clock::now();
+                auto delta = duration_cast<milliseconds>(this_tick - last_tick_);
+                last_tick_ = this_tick;
+                Call(delta);
             }
             ScheduleTick();
         }
     }
 
+    void RunSteps() {
+        const FixedStepSchedule::Steps steps = schedule_->Advance(Clock::now());
+        for (unsigned i = 0; i + 1 < steps.count; ++i) {
+            Call(period_);
+        }
+        Call(steps.last_delta);
+
+        if (schedule_->GetStats().steps >= STATS_PERIOD) {
+            if (stats_handler_) {
+                stats_handler_(schedule_->GetStats());
+            }
+            schedule_->ResetStats();
+        }
+    }
+
+    void Call(std::chrono::milliseconds delta) {
+        try {
+            handler_(delta);
+        } catch (...) {
+        }
+    }
+
     using Clock = std::chrono::steady_clock;
 
     Strand strand_;
@@ -61,4 +184,7 @@ private:
     net::steady_timer timer_{strand_};
     Handler handler_;
     std::chrono::steady_clock::time_point last_tick_;
+    // Есть только в режиме с фиксированным шагом
+    std::optional<FixedStepSchedule> schedule_;
+    StatsHandler stats_handler_;
 };
\ No newline at end of file
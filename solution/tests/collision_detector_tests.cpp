@@ -0,0 +1,240 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/domain_model/collision_detector.h"
+#include "../src/domain_model/model_game.h"
+
+namespace {
+
+// Число выделений памяти во всей программе
+std::atomic<size_t> allocations_count = 0;
+
+}  // namespace
+
+void* operator new(std::size_t size) {
+    ++allocations_count;
+    if (void* ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+namespace {
+
+using namespace collision_detector;
+
+class VectorProvider : public ItemGathererProvider {
+public:
+    std::vector<Item> items;
+    std::vector<Gatherer> gatherers;
+
+    size_t ItemsCount() const override {
+        return items.size();
+    }
+    Item GetItem(size_t idx) const override {
+        return items[idx];
+    }
+    size_t GatherersCount() const override {
+        return gatherers.size();
+    }
+    Gatherer GetGatherer(size_t idx) const override {
+        return gatherers[idx];
+    }
+};
+
+// Те же предметы, но отдаёт их одним блоком
+class ArrayProvider : public VectorProvider {
+public:
+    explicit ArrayProvider(const VectorProvider& other)
+        : VectorProvider(other) {
+        for (const Item& item : items) {
+            x.push_back(item.position.x);
+            y.push_back(item.position.y);
+            width.push_back(item.width);
+        }
+    }
+
+    std::optional<ItemsView> GetItemsView() const override {
+        return ItemsView{x.data(), y.data(), width.data(), x.size()};
+    }
+
+    std::vector<double> x;
+    std::vector<double> y;
+    std::vector<double> width;
+};
+
+// Случайный мир size x size: собаки в основном идут по осям на небольшой шаг,
+// часть стоит на месте, часть пересекает всю карту по диагонали
+VectorProvider MakeRandomProvider(std::mt19937& rng, size_t items_count, size_t gatherers_count, double size) {
+    std::uniform_real_distribution<double> coord(-size / 2, size / 2);
+    std::uniform_real_distribution<double> step(-1.0, 1.0);
+    std::uniform_real_distribution<double> width(0.0, 0.5);
+    std::uniform_int_distribution<int> kind(0, 9);
+
+    VectorProvider provider;
+    for (size_t i = 0; i < items_count; ++i) {
+        provider.items.push_back({{coord(rng), coord(rng)}, kind(rng) == 0 ? 0.0 : width(rng)});
+    }
+    for (size_t g = 0; g < gatherers_count; ++g) {
+        geom::Point2D start{coord(rng), coord(rng)};
+        geom::Point2D end = start;
+        switch (kind(rng)) {
+            case 0:
+                break;
+            case 1:
+                end = {coord(rng), coord(rng)};
+                break;
+            case 2:
+                end.x += step(rng);
+                end.y += step(rng);
+                break;
+            default:
+                (kind(rng) % 2 == 0 ? end.x : end.y) += step(rng);
+        }
+        provider.gatherers.push_back({start, end, width(rng)});
+    }
+    return provider;
+}
+
+bool IsSameEvents(const std::vector<GatheringEvent>& lhs, const std::vector<GatheringEvent>& rhs) {
+    return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(),
+                      [](const GatheringEvent& l, const GatheringEvent& r) {
+                          return l.item_id == r.item_id && l.gatherer_id == r.gatherer_id
+                              && l.sq_distance == r.sq_distance && l.time == r.time;
+                      });
+}
+
+}  // namespace
+
+SCENARIO("Gather events") {
+    GIVEN("a dog walking along a row of items") {
+        VectorProvider provider;
+        for (int i = 0; i < 50; ++i) {
+            provider.items.push_back({{static_cast<double>(i), i % 2 == 0 ? 0.5 : 2.0}, 0.0});
+        }
+        provider.gatherers.push_back({{-0.5, 0}, {10.5, 0}, 0.6});
+
+        THEN("only items within the gather radius are collected in order of time") {
+            const auto events = FindGatherEvents(provider);
+            REQUIRE(events.size() == 6);
+            for (size_t k = 0; k < events.size(); ++k) {
+                CHECK(events[k].item_id == 2 * k);
+                CHECK(events[k].gatherer_id == 0);
+            }
+            CHECK(IsSameEvents(events, FindGatherEventsBruteForce(provider)));
+        }
+    }
+
+    GIVEN("random worlds") {
+        std::mt19937 rng(42);
+
+        THEN("the grid finds the same events as the brute force") {
+            for (size_t items_count : {0, 10, 100, 1000}) {
+                for (double size : {5.0, 50.0, 1000.0}) {
+                    const VectorProvider provider = MakeRandomProvider(rng, items_count, 300, size);
+                    const auto expected = FindGatherEventsBruteForce(provider);
+                    INFO("items: " << items_count << ", size: " << size);
+                    CHECK(IsSameEvents(FindGatherEvents(provider), expected));
+                    CHECK(IsSameEvents(FindGatherEvents(ArrayProvider(provider)), expected));
+                }
+            }
+        }
+    }
+}
+
+SCENARIO("Batch point collection") {
+    GIVEN("a segment and a block of items") {
+        std::mt19937 rng(7);
+        const ArrayProvider provider(MakeRandomProvider(rng, COLLECT_BATCH_SIZE, 0, 4.0));
+        const ItemsView items = *provider.GetItemsView();
+        const geom::Point2D a{-1.0, 0.3};
+        const geom::Point2D b{1.5, -0.2};
+        const double gatherer_width = 0.6;
+
+        THEN("every block size gives the same results as TryCollectPoint") {
+            for (size_t count = 0; count <= COLLECT_BATCH_SIZE; ++count) {
+                CollectionBatch batch;
+                const uint64_t mask = TryCollectPoints(a, b, gatherer_width, {items.x, items.y, items.width, count}, batch);
+                for (size_t i = 0; i < COLLECT_BATCH_SIZE; ++i) {
+                    INFO("count: " << count << ", item: " << i);
+                    if (i >= count) {
+                        CHECK((mask >> i & 1) == 0);
+                        continue;
+                    }
+                    const CollectionResult expected = TryCollectPoint(a, b, {items.x[i], items.y[i]});
+                    CHECK(batch.sq_distance[i] == expected.sq_distance);
+                    CHECK(batch.proj_ratio[i] == expected.proj_ratio);
+                    CHECK(static_cast<bool>(mask >> i & 1) == expected.IsCollected(gatherer_width + items.width[i]));
+                }
+            }
+        }
+    }
+}
+
+SCENARIO("Session gathering") {
+    GIVEN("a session with an office, loot off the road and moving dogs") {
+        auto map = std::make_shared<model::Map>(model::Map::Id{"map"}, "Map");
+        map->AddOffice(model::Office{model::Office::Id{"office"}, {50, 0}, {0, 0}});
+        map->SetBagCapacity(3);
+        model::GameSession session(map);
+
+        for (int i = 0; i < 100; ++i) {
+            model::LootObject loot_object(0, 10, {static_cast<double>(i), 10.});
+            session.AddLootObject(loot_object);
+        }
+        std::vector<std::shared_ptr<model::Dog>> dogs;
+        for (int i = 0; i < 10; ++i) {
+            auto& dog = dogs.emplace_back(std::make_shared<model::Dog>(i));
+            session.AddDog(dog);
+        }
+        // Собаки идут вдоль дороги y = 0 через офис, каждая со своим смещением
+        const auto move_dogs = [&dogs](double from_x, double to_x) {
+            for (size_t i = 0; i < dogs.size(); ++i) {
+                dogs[i]->SetGatherer({from_x + i, 0.}, {to_x + i, 0.});
+            }
+        };
+
+        THEN("collecting does not allocate once buffers are warm") {
+            move_dogs(40., 60.);
+            session.CollectAndSendItems();
+            move_dogs(30., 70.);
+
+            const size_t before = allocations_count;
+            session.CollectAndSendItems();
+            CHECK(allocations_count == before);
+        }
+
+        WHEN("loot appears on the road, is picked up and delivered") {
+            model::LootObject loot_object(0, 10, {25., 0.});
+            session.AddLootObject(loot_object);
+            move_dogs(20., 30.);
+            session.CollectAndSendItems();
+
+            THEN("only the first dog to reach it takes it") {
+                CHECK(session.GetLootObjects().count(loot_object.GetId()) == 0);
+                CHECK(dogs[5]->GetState().bag.loot_objects.size() == 1);
+                CHECK(dogs[5]->GetState().score == 10);
+                CHECK(dogs[4]->GetState().bag.loot_objects.empty());
+
+                move_dogs(40., 50.);
+                session.CollectAndSendItems();
+                CHECK(dogs[5]->GetState().bag.loot_objects.empty());
+                CHECK(dogs[5]->GetState().score == 10);
+                CHECK(session.GetSizeLootObjects() == 100);
+            }
+        }
+    }
+}
@@ -0,0 +1,92 @@
+#include <atomic>
+#include <optional>
+#include <string>
+#include <thread>
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/domain_model/dog_store.h"
+#include "../src/domain_model/state_epoch.h"
+
+using namespace model;
+
+namespace {
+    const std::string TAG = "[DogStore]";
+}
+
+TEST_CASE("DOG STORE VERSIONS", TAG) {
+    // Больше одного блока строк
+    constexpr size_t ROWS = 600;
+    const auto motion_at = [](size_t row, double step) {
+        DogStore::Motion motion;
+        motion.position = {static_cast<double>(row), step};
+        motion.gather_start = {static_cast<double>(row), step - 1};
+        motion.gather_end = motion.position;
+        motion.score = static_cast<int>(step);
+        return motion;
+    };
+    const auto check_rows = [&](const auto& get, double step) {
+        for(size_t row = 0; row < ROWS; ++row) {
+            const DogStore::Motion motion = get(row);
+            const DogStore::Motion expected = motion_at(row, step);
+            if(motion.position != expected.position || motion.gather_start != expected.gather_start
+               || motion.score != expected.score) {
+                return false;
+            }
+        }
+        return true;
+    };
+    const auto move_all = [&](DogStore& store, double step) {
+        for(size_t row = 0; row < ROWS; ++row) {
+            const DogStore::Motion motion = motion_at(row, step);
+            store.SetGatherer(row, motion.gather_start, motion.gather_end);
+            store.SetPosition(row, motion.position);
+            store.SetScore(row, motion.score);
+        }
+    };
+
+    DogStore store;
+    for(size_t row = 0; row < ROWS; ++row) {
+        CHECK(store.Add(motion_at(row, 0)) == row);
+    }
+
+    std::optional<EpochPin> first(std::in_place);
+    move_all(store, 1);
+    std::optional<EpochPin> second(std::in_place);
+    move_all(store, 2);
+    move_all(store, 3);
+
+    CHECK(check_rows([&](size_t row) { return store.Get(row, first->GetEpoch()); }, 0));
+    CHECK(check_rows([&](size_t row) { return store.Get(row, second->GetEpoch()); }, 1));
+    CHECK(check_rows([&](size_t row) { return store.Get(row); }, 3));
+    CHECK(store.GetEpoch(0) > second->GetEpoch());
+
+    SECTION("pinned rows are read while the game moves on") {
+        std::atomic<bool> stop = false;
+        std::atomic<int> failures = 0;
+        std::thread reader([&] {
+            while(!stop) {
+                if(!check_rows([&](size_t row) { return store.Get(row, second->GetEpoch()); }, 1)) {
+                    ++failures;
+                }
+            }
+        });
+        for(int step = 4; step < 200; ++step) {
+            EpochPin pin;
+            move_all(store, step);
+        }
+        stop = true;
+        reader.join();
+        CHECK(failures == 0);
+        CHECK(check_rows([&](size_t row) { return store.Get(row, first->GetEpoch()); }, 0));
+    }
+
+    SECTION("released rows stay in place") {
+        first.reset();
+        second.reset();
+        store.Release(1);
+        CHECK(store.GetActiveCount() == ROWS - 1);
+        CHECK_FALSE(store.IsActive(1));
+        CHECK(store.Add(motion_at(ROWS, 0)) == ROWS);
+        CHECK(check_rows([&](size_t row) { return store.Get(row); }, 3));
+    }
+}
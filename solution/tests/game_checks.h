@@ -0,0 +1,44 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/application_model/game.h"
+
+namespace game_checks {
+
+// Игроки, собаки и предметы loaded_game совпадают с game
+inline void CheckGamesEqual(const model::Game& game, const model::Game& loaded_game) {
+    REQUIRE(game.GetSessions().size() == loaded_game.GetSessions().size());
+    for(const auto& [session, players_tokens] : game.GetSessions()) {
+        const auto& token_to_player = players_tokens.GetTokenToPlayerMap();
+        for(const auto& [token, player] : token_to_player) {
+            std::shared_ptr<const model::Player> loaded_player = loaded_game.FindPlayer(token);
+            REQUIRE(loaded_player);
+            CHECK(loaded_player->GetId() == player->GetId());
+            CHECK(loaded_player->GetName() == player->GetName());
+            CHECK(loaded_player->GetDog()->GetPosition().x == player->GetDog()->GetPosition().x);
+            CHECK(loaded_player->GetDog()->GetPosition().y == player->GetDog()->GetPosition().y);
+            CHECK(loaded_player->GetDog()->GetSpeed().x == player->GetDog()->GetSpeed().x);
+            CHECK(loaded_player->GetDog()->GetSpeed().y == player->GetDog()->GetSpeed().y);
+            CHECK(loaded_player->GetDog()->GetBag().loot_objects.size() == player->GetDog()->GetBag().loot_objects.size());
+            CHECK(loaded_player->GetDog()->GetScore() == player->GetDog()->GetScore());
+        }
+        auto loaded_it = std::find_if(loaded_game.GetSessions().begin(), loaded_game.GetSessions().end(), [&session](const auto& item) {
+            return item.first->GetMap()->GetId() == session->GetMap()->GetId();
+        });
+        REQUIRE(loaded_it != loaded_game.GetSessions().end());
+        std::shared_ptr<model::GameSession> loaded_session = loaded_it->first;
+        CHECK(loaded_session->GetSizeLootObjects() == session->GetSizeLootObjects());
+        for(const auto& [id, loot_object] : session->GetLootObjects()) {
+            REQUIRE(loaded_session->GetLootObjects().contains(id));
+            const auto& loaded_loot_object = loaded_session->GetLootObjects().at(id);
+            CHECK(loaded_loot_object->GetPosition().x == loot_object->GetPosition().x);
+            CHECK(loaded_loot_object->GetPosition().y == loot_object->GetPosition().y);
+            CHECK(loaded_loot_object->GetType() == loot_object->GetType());
+        }
+    }
+}
+
+}  // namespace game_checks
@@ -0,0 +1,146 @@
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/application_model/game.h"
+#include "../src/serialization/model_serialization.h"
+
+#include "game_checks.h"
+#include "test_maps.h"
+
+using namespace model;
+using game_checks::CheckGamesEqual;
+using test_maps::MakeTestMap;
+
+namespace {
+    const std::string TAG = "[Game]";
+}
+
+TEST_CASE("PARALLEL TICK", TAG) {
+    const std::vector<std::string> map_ids{"map1", "map2", "map3", "map4", "crowd"};
+    model::Game game;
+    for(const auto& map_id : map_ids) {
+        game.AddMap(MakeTestMap(map_id));
+        auto map = game.FindMap(model::Map::Id{map_id});
+        // На последней карте собак хватает, чтобы двигать их блоками в разных потоках
+        const int dogs_count = map_id == "crowd" ? 5 * model::GameSession::MOVE_CHUNK_SIZE : 8;
+        for(int i = 0; i < dogs_count; ++i) {
+            auto [player, token] = game.JoinGame(map, map_id + "_player" + std::to_string(i), true);
+            game.ApplyPlayerAction(*player, i % 2 ? "R" : "U");
+        }
+        game.GetGameSession(map)->GenerateLootObjects(20);
+    }
+
+    // Та же игра, обновляемая последовательно
+    const std::string filename = "parallel_tick_state.bin";
+    model::Save(game, filename, {.format = SnapshotFormat::BINARY, .generations = 0});
+    model::Game serial_game;
+    for(const auto& map_id : map_ids) {
+        serial_game.AddMap(MakeTestMap(map_id));
+    }
+    REQUIRE(model::Restore(serial_game, filename));
+
+    game.SetTickThreads(4);
+    CHECK(game.GetTickThreads() == 4);
+    CHECK(serial_game.GetTickThreads() == 1);
+    for(int tick = 0; tick < 20; ++tick) {
+        game.UpdateGame(0.1);
+        serial_game.UpdateGame(0.1);
+    }
+    CheckGamesEqual(game, serial_game);
+}
+
+TEST_CASE("PLAYER INDEX", TAG) {
+    model::Game game;
+    game.AddMap(MakeTestMap("map1"));
+    game.AddMap(MakeTestMap("map2"));
+    auto [player1, token1] = game.JoinGame(game.FindMap(model::Map::Id{"map1"}), "player1", false);
+    auto [player2, token2] = game.JoinGame(game.FindMap(model::Map::Id{"map2"}), "player2", false);
+
+    REQUIRE(game.FindPlayer(token2));
+    CHECK(game.FindPlayer(token2) == player2);
+    CHECK(game.FindPlayer(token2)->GetName() == "player2");
+    CHECK(game.FindPlayer(token2) == game.FindPlayer(player2->GetId()));
+    CHECK(game.FindPlayer(player1->GetId())->GetName() == "player1");
+    CHECK_FALSE(game.FindPlayer(model::Token{std::string(32, 'f')}));
+    CHECK_FALSE(game.FindPlayer(player2->GetId() + 100));
+
+    // Восстановленный игрок с тем же токеном заменяет прежнего и в индексах
+    const int new_id = player2->GetId() + 100;
+    model::Player restored(std::make_shared<model::Dog>(new_id), "restored", new_id);
+    game.AddRestoredPlayer(player2->GetPlayersSession(), restored, token2);
+    CHECK(game.FindPlayer(token2)->GetName() == "restored");
+    CHECK(game.FindPlayer(new_id) == game.FindPlayer(token2));
+    CHECK_FALSE(game.FindPlayer(player2->GetId()));
+}
+
+TEST_CASE("SHARED MAPS", TAG) {
+    model::Game game;
+    game.AddMap(MakeTestMap());
+    const model::Map::Id id{"map1"};
+
+    // Карта загружается один раз, а сессия и поиск отдают тот же экземпляр
+    std::shared_ptr<const model::Map> map = game.FindMap(id);
+    REQUIRE(map);
+    CHECK(game.FindMap(id) == map);
+    CHECK(game.GetMaps().front() == map);
+    CHECK(game.GetGameSession(id)->GetMap() == map);
+    CHECK_FALSE(game.FindMap(model::Map::Id{"map2"}));
+}
+
+TEST_CASE("SESSION STATE VERSION", TAG) {
+    model::Game game;
+    game.AddMap(MakeTestMap());
+    std::shared_ptr<model::GameSession> session = game.GetGameSession(model::Map::Id{"map1"});
+
+    // Версия меняется при входе, тике, действии игрока и появлении предмета,
+    // а чтение её не меняет
+    uint64_t version = session->GetStateVersion();
+    auto [player, token] = game.JoinGame(game.FindMap(model::Map::Id{"map1"}), "player", false);
+    CHECK(session->GetStateVersion() != version);
+
+    version = session->GetStateVersion();
+    CHECK(session->GetStateVersion() == version);
+    game.UpdateGame(0.1);
+    CHECK(session->GetStateVersion() != version);
+
+    version = session->GetStateVersion();
+    model::LootObject loot_object(geom::Point2D{1., 0.}, 0.);
+    session->AddLootObject(loot_object);
+    CHECK(session->GetStateVersion() != version);
+
+    version = session->GetStateVersion();
+    game.ApplyPlayerAction(*player, "R");
+    CHECK(session->GetStateVersion() != version);
+}
+
+TEST_CASE("PLAYER LOOKUP DURING JOIN", TAG) {
+    model::Game game;
+    game.AddMap(MakeTestMap());
+    std::shared_ptr<const model::Map> map = game.FindMap(model::Map::Id{"map1"});
+    auto [first, token] = game.JoinGame(map, "first", false);
+
+    // Потоки запросов ищут игроков, пока strand игры добавляет новых
+    std::atomic<bool> joined = false;
+    std::atomic<int> misses = 0;
+    std::thread reader([&] {
+        while(!joined) {
+            if(game.FindPlayer(token) != first || !game.FindPlayer(first->GetId())) {
+                ++misses;
+            }
+        }
+    });
+    std::vector<model::Token> tokens;
+    for(int i = 0; i < 1000; ++i) {
+        tokens.push_back(game.JoinGame(map, "player" + std::to_string(i), false).second);
+    }
+    joined = true;
+    reader.join();
+
+    CHECK(misses == 0);
+    for(const model::Token& joined_token : tokens) {
+        CHECK(game.FindPlayer(joined_token));
+    }
+}
@@ -1,6 +1,12 @@
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 
 #include "../src/serialization/model_serialization.h"
+#include "../src/serialization/snapshot_writer.h"
+#include "../src/serialization/snapshot_file.h"
+#include "../src/serialization/action_journal.h"
+#include "../src/serialization/flat_snapshot.h"
 
 #define _USE_MATH_DEFINES
 
@@ -10,6 +16,9 @@
 #include "../src/domain_model/collision_detector.h"
 #include "../src/domain_model/model_game.h"
 
+#include "game_checks.h"
+#include "test_maps.h"
+
 #include <boost/serialization/export.hpp>
 #include <boost/archive/text_oarchive.hpp>
 #include <boost/archive/text_iarchive.hpp>
@@ -18,6 +27,7 @@
 
 #include <iostream>
 #include <sstream>
+#include <filesystem>
 #include <fstream>
 #include <stdexcept>
 
@@ -207,7 +217,7 @@ TEST_CASE("DOG SERIALIZATION", TAG) {
     dog.SetPosition({1., 2.});
     dog.SetSpeedValue(5.);
     dog.SetSpeed({6., 7.});
-    dog.SetDirection(Direction::SOUTH);
+    dog.RestoreDirection(Direction::SOUTH);
     dog.SetGatherer({0., 9.}, {7., 10.});
     dog.SetWidth(0.55);
     dog.SetBag(bag);
@@ -258,10 +268,582 @@ TEST_CASE("DOG SERIALIZATION", TAG) {
     CHECK(dog.GetSpeed().x == loaded_dog.GetSpeed().x);
     CHECK(dog.GetSpeed().y == loaded_dog.GetSpeed().y);
     CHECK(dog.GetDirectionEnum() == loaded_dog.GetDirectionEnum());
-    CHECK(dog.start_pos.x == loaded_dog.start_pos.x);
-    CHECK(dog.start_pos.y == loaded_dog.start_pos.y);
-    CHECK(dog.end_pos.x == loaded_dog.end_pos.x);
-    CHECK(dog.end_pos.y == loaded_dog.end_pos.y);
-    CHECK(dog.width == loaded_dog.width);
+    CHECK(dog.GetGatherer().start_pos.x == loaded_dog.GetGatherer().start_pos.x);
+    CHECK(dog.GetGatherer().start_pos.y == loaded_dog.GetGatherer().start_pos.y);
+    CHECK(dog.GetGatherer().end_pos.x == loaded_dog.GetGatherer().end_pos.x);
+    CHECK(dog.GetGatherer().end_pos.y == loaded_dog.GetGatherer().end_pos.y);
+    CHECK(dog.GetGatherer().width == loaded_dog.GetGatherer().width);
+
+}
+
+namespace {
+
+using test_maps::MakeTestMap;
+using game_checks::CheckGamesEqual;
+
+}  // namespace
+
+TEST_CASE("GAME SNAPSHOT FORMATS", TAG) {
+    model::Game game;
+    game.AddMap(MakeTestMap());
+    auto map = game.FindMap(model::Map::Id{"map1"});
+
+    for(int i = 0; i < 5; ++i) {
+        auto [player, token] = game.JoinGame(map, "player" + std::to_string(i), true);
+        game.ApplyPlayerAction(*player, i % 2 ? "R" : "D");
+    }
+    game.GetGameSession(map)->GenerateLootObjects(7);
+    game.UpdateGame(0.25);
+
+    for(auto format : {SnapshotFormat::TEXT, SnapshotFormat::BINARY}) {
+        std::stringstream ss;
+        WriteSnapshot(CollectSessionReprs(game), ss, format);
+
+        auto detected = DetectSnapshotFormat(ss);
+        REQUIRE(detected);
+        CHECK(*detected == format);
+
+        model::Game loaded_game;
+        loaded_game.AddMap(MakeTestMap());
+        for(const auto& session_repr : ReadSnapshot(ss)) {
+            RestoreSession(loaded_game, session_repr);
+        }
+        CheckGamesEqual(game, loaded_game);
+    }
+
+    std::stringstream garbage{"not a snapshot"};
+    CHECK_FALSE(DetectSnapshotFormat(garbage));
+    CHECK_THROWS(ReadSnapshot(garbage));
+    CHECK_THROWS(ParseSnapshotFormat("xml"));
+}
+
+TEST_CASE("ASYNC SNAPSHOT WRITER", TAG) {
+    model::Game game;
+    game.AddMap(MakeTestMap());
+    auto map = game.FindMap(model::Map::Id{"map1"});
+    for(int i = 0; i < 3; ++i) {
+        game.JoinGame(map, "player" + std::to_string(i), true);
+    }
+    game.GetGameSession(map)->GenerateLootObjects(4);
+
+    const std::string filename = "async_snapshot_state.bin";
+    int written = 0;
+    {
+        SnapshotWriter writer([&written](std::chrono::microseconds, uint64_t) { ++written; },
+                              [](const std::exception& ex) { FAIL(ex.what()); });
+        writer.Write(CollectSessionReprs(game), filename, {.format = SnapshotFormat::BINARY});
+        writer.Flush();
+        CHECK(written == 1);
+    }
+
+    model::Game loaded_game;
+    loaded_game.AddMap(MakeTestMap());
+    model::Restore(loaded_game, filename);
+    CheckGamesEqual(game, loaded_game);
+}
+
+TEST_CASE("PINNED SNAPSHOTS", TAG) {
+    model::Game game;
+    game.AddMap(MakeTestMap());
+    auto map = game.FindMap(model::Map::Id{"map1"});
+    std::vector<std::shared_ptr<model::Player>> players;
+    for(int i = 0; i < 3; ++i) {
+        players.push_back(game.JoinGame(map, "player" + std::to_string(i), false).first);
+        game.ApplyPlayerAction(*players.back(), "R");
+    }
+    auto session = game.GetGameSession(map);
+    session->GenerateLootObjects(5);
+    game.UpdateGame(0.2);
+
+    const auto restore = [](model::Game& target, const std::vector<GameSessionReprTmp>& game_ses_reprs) {
+        target.AddMap(MakeTestMap());
+        for(const auto& session_repr : game_ses_reprs) {
+            RestoreSession(target, session_repr);
+        }
+    };
+    model::Game expected_game;
+    restore(expected_game, CollectSessionReprs(game));
+
+    PinnedGameState pinned(game);
+    game.UpdateGame(0.5);
+    players[1]->GetDog()->AddScore(5);
+    session->RemoveLootObject(session->GetLootObjects().begin()->first);
+    // Столько предметов, что список предметов сессии переписывается заново
+    session->GenerateLootObjects(2000);
+    game.JoinGame(map, "late player", false);
+
+    PinnedGameState later(game);
+    const int later_loot_count = session->GetSizeLootObjects();
+    const int later_score = players[2]->GetDog()->GetScore();
+    players[2]->GetDog()->AddScore(3);
+    game.UpdateGame(0.5);
+
+    model::Game pinned_game;
+    restore(pinned_game, pinned.CollectSessionReprs());
+    CheckGamesEqual(expected_game, pinned_game);
+    CheckGamesEqual(pinned_game, expected_game);
+
+    model::Game later_game;
+    restore(later_game, later.CollectSessionReprs());
+    CHECK(later_game.GetSessions().begin()->second.GetTokenToPlayerMap().size() == 4);
+    CHECK(later_game.GetSessions().begin()->first->GetSizeLootObjects() == later_loot_count);
+    for(const auto& [token, player] : later_game.GetSessions().begin()->second.GetTokenToPlayerMap()) {
+        if(player->GetId() == players[2]->GetId()) {
+            CHECK(player->GetDog()->GetScore() == later_score);
+        }
+    }
+
+    SECTION("writer collects pinned state in its own thread") {
+        const std::string filename = "pinned_snapshot_state.bin";
+        {
+            SnapshotWriter writer(nullptr, [](const std::exception& ex) { FAIL(ex.what()); });
+            writer.Write(std::move(pinned), filename, {.format = SnapshotFormat::BINARY});
+            game.ApplyPlayerAction(*players[0], "L");
+            game.UpdateGame(0.5);
+        }
+        model::Game loaded_game;
+        loaded_game.AddMap(MakeTestMap());
+        model::Restore(loaded_game, filename);
+        CheckGamesEqual(expected_game, loaded_game);
+        CheckGamesEqual(loaded_game, expected_game);
+    }
+}
+
+TEST_CASE("STATE FILE GENERATIONS AND CORRUPTION", TAG) {
+    model::Game game;
+    game.AddMap(MakeTestMap());
+    auto map = game.FindMap(model::Map::Id{"map1"});
+    game.JoinGame(map, "first", true);
+
+    const std::string filename = "generations_state.bin";
+    for(unsigned generation = 0; generation <= 3; ++generation) {
+        std::filesystem::remove(GetSnapshotGenerationName(filename, generation));
+    }
+
+    const SnapshotOptions options{.format = SnapshotFormat::BINARY, .generations = 2};
+    model::Save(game, filename, options);
+    game.JoinGame(map, "second", true);
+    model::Save(game, filename, options);
+    game.JoinGame(map, "third", true);
+    model::Save(game, filename, options);
+    model::Save(game, filename, options);
+
+    CHECK(std::filesystem::exists(GetSnapshotGenerationName(filename, 1)));
+    CHECK(std::filesystem::exists(GetSnapshotGenerationName(filename, 2)));
+    CHECK_FALSE(std::filesystem::exists(GetSnapshotGenerationName(filename, 3)));
+    CHECK_FALSE(std::filesystem::exists(filename + ".tmp"));
+
+    SECTION("newest valid generation is restored") {
+        model::Game loaded_game;
+        loaded_game.AddMap(MakeTestMap());
+        CHECK(model::Restore(loaded_game, filename, options)->filename == filename);
+        CheckGamesEqual(game, loaded_game);
+    }
+
+    SECTION("corrupted payload falls back to the previous generation") {
+        {
+            std::fstream file(filename, std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+            file.seekp(sizeof(SnapshotHeader) + 10);
+            file.put('\x7f');
+        }
+        CHECK_THROWS_AS(ReadSnapshotFilePayload(filename), SnapshotCorrupted);
+
+        model::Game loaded_game;
+        loaded_game.AddMap(MakeTestMap());
+        CHECK(model::Restore(loaded_game, filename, options)->filename == GetSnapshotGenerationName(filename, 1));
+        CheckGamesEqual(game, loaded_game);
+    }
+
+    SECTION("truncated file is detected before parsing") {
+        std::filesystem::resize_file(filename, std::filesystem::file_size(filename) / 2);
+        CHECK_THROWS_AS(ReadSnapshotFilePayload(filename), SnapshotCorrupted);
+
+        std::filesystem::remove(GetSnapshotGenerationName(filename, 1));
+        std::filesystem::remove(GetSnapshotGenerationName(filename, 2));
+        model::Game loaded_game;
+        loaded_game.AddMap(MakeTestMap());
+        CHECK_THROWS(model::Restore(loaded_game, filename, options));
+    }
+
+    SECTION("state file without header is still readable") {
+        {
+            std::ofstream legacy(filename, std::ios_base::out | std::ios_base::trunc);
+            WriteSnapshot(CollectSessionReprs(game), legacy, SnapshotFormat::TEXT);
+        }
+        model::Game loaded_game;
+        loaded_game.AddMap(MakeTestMap());
+        CHECK(model::Restore(loaded_game, filename, options)->filename == filename);
+        CheckGamesEqual(game, loaded_game);
+    }
+}
+
+TEST_CASE("DELTA SNAPSHOTS", TAG) {
+    model::Game game;
+    game.AddMap(MakeTestMap());
+    auto map = game.FindMap(model::Map::Id{"map1"});
+    std::vector<std::shared_ptr<model::Player>> players;
+    for(int i = 0; i < 4; ++i) {
+        players.push_back(game.JoinGame(map, "player" + std::to_string(i), false).first);
+    }
+    auto session = game.GetGameSession(map);
+    // Предметы в стороне от пути собак, чтобы их никто не подобрал
+    for(int i = 0; i < 3; ++i) {
+        model::LootObject loot_object(i % 2, 10, geom::Point2D{40., 10. + 5. * i}, 0.);
+        session->AddLootObject(loot_object);
+    }
+    game.UpdateGame(0.1);
+
+    const std::string filename = "delta_state.bin";
+    const SnapshotOptions options{.format = SnapshotFormat::BINARY, .generations = 0, .delta_count = 4};
+    SnapshotId base = WriteSnapshotFile(CollectSessionReprs(game), filename, options);
+    ClearDirtyState(game);
+
+    auto delta_reprs = CollectSessionDeltaReprs(game);
+    CHECK(delta_reprs.empty());
+
+    game.ApplyPlayerAction(*players[1], "R");
+    game.UpdateGame(0.5);
+    players[2]->GetDog()->AddScore(7);
+    session->RemoveLootObject(session->GetLootObjects().begin()->first);
+    for(int i = 0; i < 2; ++i) {
+        model::LootObject loot_object(0, 10, geom::Point2D{20. + 5. * i, 0.}, 0.);
+        session->AddLootObject(loot_object);
+    }
 
+    delta_reprs = CollectSessionDeltaReprs(game);
+    REQUIRE(delta_reprs.size() == 1);
+    CHECK(delta_reprs[0].GetPlayerRepr().size() == 2);
+    CHECK(delta_reprs[0].GetLootsObjectRepr().size() == 2);
+    CHECK(delta_reprs[0].GetRemovedLootIds().size() == 1);
+    WriteSnapshotDeltaFile(delta_reprs, filename, base, 1, options);
+
+    players.push_back(game.JoinGame(map, "late player", false).first);
+    game.ApplyPlayerAction(*players[1], "");
+    game.UpdateGame(0.2);
+    WriteSnapshotDeltaFile(CollectSessionDeltaReprs(game), filename, base, 2, options);
+
+    SECTION("restore replays the delta chain") {
+        model::Game loaded_game;
+        loaded_game.AddMap(MakeTestMap());
+        model::Restore(loaded_game, filename, options);
+        CheckGamesEqual(game, loaded_game);
+    }
+
+    SECTION("deltas of another full snapshot are ignored") {
+        std::filesystem::rename(GetSnapshotDeltaName(filename, 2), "delta_state.keep");
+        WriteSnapshotFile(CollectSessionReprs(game), filename, options);
+        CHECK_FALSE(std::filesystem::exists(GetSnapshotDeltaName(filename, 1)));
+        std::filesystem::rename("delta_state.keep", GetSnapshotDeltaName(filename, 1));
+
+        model::Game loaded_game;
+        loaded_game.AddMap(MakeTestMap());
+        model::Restore(loaded_game, filename, options);
+        CheckGamesEqual(game, loaded_game);
+    }
+}
+
+TEST_CASE("ACTION JOURNAL REPLAY", TAG) {
+    const std::string filename = "journal_state.bin";
+    RemoveJournalSegments(filename);
+    const SnapshotOptions options{.format = SnapshotFormat::BINARY, .generations = 0};
+
+    model::Game game;
+    game.AddMap(MakeTestMap());
+    auto map = game.FindMap(model::Map::Id{"map1"});
+    model::Save(game, filename, options, 1);
+
+    ActionJournal journal(filename, JournalSyncPolicy::ALWAYS, 1, nullptr);
+    auto join = [&](const std::string& name) {
+        auto [player, token] = game.JoinGame(map, name, true);
+        journal.Append(JoinRecord(map->GetId(), *player, token));
+        return player;
+    };
+    auto move = [&](const std::shared_ptr<model::Player>& player, const std::string& direction) {
+        game.ApplyPlayerAction(*player, direction);
+        journal.Append(ActionRecord(player->GetId(), direction));
+    };
+    auto tick = [&](int64_t time_delta_ms) {
+        model::Game::GeneratedLoot generated_loot = game.GenerateLoot(time_delta_ms);
+        game.UpdateGame(time_delta_ms / 1000.);
+        journal.Append(TickRecord(time_delta_ms, generated_loot));
+    };
+
+    auto player1 = join("player1");
+    auto player2 = join("player2");
+    move(player1, "R");
+    tick(100);
+    move(player2, "D");
+    tick(200);
+
+    bool committed = false;
+    journal.WhenCommitted([&committed] { committed = true; });
+    journal.Flush();
+    CHECK(committed);
+
+    SECTION("journal is replayed on top of the snapshot") {
+        model::Game loaded_game;
+        loaded_game.AddMap(MakeTestMap());
+        auto restored = model::Restore(loaded_game, filename, options);
+        REQUIRE(restored);
+        CHECK(restored->journal_lsn == 1);
+
+        JournalReplayResult replayed = ReplayJournal(loaded_game, filename, restored->journal_lsn);
+        CHECK(replayed.records == 6);
+        CHECK(replayed.next_lsn == 7);
+        CheckGamesEqual(game, loaded_game);
+    }
+
+    SECTION("segments covered by a snapshot are removed") {
+        const uint64_t journal_lsn = journal.Rotate();
+        model::Save(game, filename, options, journal_lsn);
+        RemoveJournalSegments(filename, journal_lsn);
+
+        move(player1, "U");
+        tick(150);
+        journal.Flush();
+        CHECK_FALSE(std::filesystem::exists(GetJournalSegmentName(filename, 1)));
+        REQUIRE(std::filesystem::exists(GetJournalSegmentName(filename, journal_lsn)));
+
+        // Незавершённая запись в конце сегмента, как после падения во время write
+        {
+            std::ofstream segment(GetJournalSegmentName(filename, journal_lsn), std::ios_base::app | std::ios_base::binary);
+            segment.write("\x40\0\0\0garbage", 11);
+        }
+
+        model::Game loaded_game;
+        loaded_game.AddMap(MakeTestMap());
+        auto restored = model::Restore(loaded_game, filename, options);
+        REQUIRE(restored);
+        CHECK(restored->journal_lsn == journal_lsn);
+
+        JournalReplayResult replayed = ReplayJournal(loaded_game, filename, restored->journal_lsn);
+        CHECK(replayed.records == 2);
+        CheckGamesEqual(game, loaded_game);
+    }
+}
+
+TEST_CASE("COMPRESSED STATE FILES", TAG) {
+    model::Game game;
+    game.AddMap(MakeTestMap());
+    auto map = game.FindMap(model::Map::Id{"map1"});
+    for(int i = 0; i < 20; ++i) {
+        auto [player, token] = game.JoinGame(map, "player" + std::to_string(i), true);
+        game.ApplyPlayerAction(*player, i % 2 ? "L" : "U");
+    }
+    game.GetGameSession(map)->GenerateLootObjects(10);
+    game.UpdateGame(0.3);
+
+    const std::string filename = "compressed_state.bin";
+    for(auto format : {SnapshotFormat::TEXT, SnapshotFormat::BINARY}) {
+        model::Save(game, filename, {.format = format, .generations = 0});
+        const auto plain_size = std::filesystem::file_size(filename);
+
+        const SnapshotOptions options{.format = format, .generations = 0, .delta_count = 1, .compression_level = 6};
+        SnapshotId base = WriteSnapshotFile(CollectSessionReprs(game), filename, options);
+        CHECK(std::filesystem::file_size(filename) < plain_size);
+        // Сжимается каждый блок сессии по отдельности
+        SnapshotBlockEntry entry;
+        std::memcpy(&entry, ReadSnapshotFilePayload(filename).data.data() + sizeof(SnapshotBlockIndex), sizeof(entry));
+        CHECK((entry.format & SNAPSHOT_ZLIB_FLAG) != 0);
+
+        ClearDirtyState(game);
+        game.GetGameSession(map)->GenerateLootObjects(2);
+        WriteSnapshotDeltaFile(CollectSessionDeltaReprs(game), filename, base, 1, options);
+
+        model::Game loaded_game;
+        loaded_game.AddMap(MakeTestMap());
+        model::Restore(loaded_game, filename, options);
+        CheckGamesEqual(game, loaded_game);
+    }
+}
+
+TEST_CASE("FLAT STATE FILES", TAG) {
+    model::Game game;
+    game.AddMap(MakeTestMap());
+    auto map = game.FindMap(model::Map::Id{"map1"});
+    for(int i = 0; i < 10; ++i) {
+        auto [player, token] = game.JoinGame(map, "player" + std::to_string(i), true);
+        game.ApplyPlayerAction(*player, i % 2 ? "R" : "D");
+        player->GetDog()->AddScore(i);
+        for(int j = 0; j < i % 3; ++j) {
+            player->GetDog()->GetBag().AddLoot(std::make_shared<model::LootObject>(j, 10, geom::Point2D{1., 2.}, 0.));
+        }
+    }
+    game.GetGameSession(map)->GenerateLootObjects(5);
+    game.UpdateGame(0.2);
+
+    const std::string filename = "flat_state.bin";
+    for(int compression_level : {0, 1}) {
+        const SnapshotOptions options{.format = SnapshotFormat::FLAT, .generations = 0, .delta_count = 1,
+                                      .compression_level = compression_level};
+        SnapshotId base = WriteSnapshotFile(CollectSessionReprs(game), filename, options);
+        ClearDirtyState(game);
+        game.UpdateGame(0.1);
+        WriteSnapshotDeltaFile(CollectSessionDeltaReprs(game), filename, base, 1, options);
+
+        model::Game loaded_game;
+        loaded_game.AddMap(MakeTestMap());
+        REQUIRE(model::Restore(loaded_game, filename, options));
+        CheckGamesEqual(game, loaded_game);
+    }
+
+    SECTION("malformed flat data is rejected before restoring") {
+        std::ostringstream out;
+        WriteSnapshot(CollectSessionReprs(game), out, SnapshotFormat::FLAT);
+        std::string data = out.str();
+        CHECK_NOTHROW(FlatSnapshot(data));
+        CHECK_THROWS(FlatSnapshot(std::string_view(data).substr(0, data.size() - 1)));
+
+        // Ссылка на имя карты за пределами таблицы строк
+        const size_t header_size = 40;
+        uint32_t bad_offset = 1'000'000;
+        std::memcpy(data.data() + header_size, &bad_offset, sizeof(bad_offset));
+        CHECK_THROWS(FlatSnapshot(data));
+    }
+}
+
+TEST_CASE("SESSION BLOCKS", TAG) {
+    const std::vector<std::string> map_ids{"map1", "map2", "map3", "map4"};
+    model::Game game;
+    for(const auto& map_id : map_ids) {
+        game.AddMap(MakeTestMap(map_id));
+        auto map = game.FindMap(model::Map::Id{map_id});
+        for(int i = 0; i < 6; ++i) {
+            auto [player, token] = game.JoinGame(map, map_id + "_player" + std::to_string(i), true);
+            game.ApplyPlayerAction(*player, i % 2 ? "R" : "D");
+        }
+        game.GetGameSession(map)->GenerateLootObjects(4);
+    }
+    game.UpdateGame(0.2);
+
+    const auto make_loaded_game = [&map_ids] {
+        model::Game loaded_game;
+        for(const auto& map_id : map_ids) {
+            loaded_game.AddMap(MakeTestMap(map_id));
+        }
+        return loaded_game;
+    };
+
+    const std::string filename = "blocks_state.bin";
+    for(auto format : {SnapshotFormat::TEXT, SnapshotFormat::BINARY, SnapshotFormat::FLAT}) {
+        for(unsigned threads : {1u, 4u}) {
+            const SnapshotOptions options{.format = format, .generations = 0, .compression_level = 1, .threads = threads};
+            model::Save(game, filename, options);
+            CHECK((*ReadSnapshotFilePayload(filename).format & SNAPSHOT_BLOCKS_FLAG) != 0);
+
+            model::Game loaded_game = make_loaded_game();
+            REQUIRE(model::Restore(loaded_game, filename, options));
+            CheckGamesEqual(game, loaded_game);
+        }
+    }
+
+    SECTION("one pool serves every save and restore") {
+        const SnapshotOptions options{.format = SnapshotFormat::BINARY, .generations = 0, .pool = std::make_shared<TickPool>(4)};
+        for(int i = 0; i < 3; ++i) {
+            model::Save(game, filename, options);
+            model::Game loaded_game = make_loaded_game();
+            REQUIRE(model::Restore(loaded_game, filename, options));
+            CheckGamesEqual(game, loaded_game);
+        }
+    }
+
+    SECTION("snapshot written as a single archive is still readable") {
+        std::ostringstream out(std::ios_base::out | std::ios_base::binary);
+        WriteSnapshot(CollectSessionReprs(game), out, SnapshotFormat::BINARY);
+        WriteSnapshotFileAtomically(filename, out.view(), static_cast<uint32_t>(SnapshotFormat::BINARY), 0);
+
+        model::Game loaded_game = make_loaded_game();
+        REQUIRE(model::Restore(loaded_game, filename));
+        CheckGamesEqual(game, loaded_game);
+    }
+
+    SECTION("block outside of the payload is rejected") {
+        const SnapshotOptions options{.format = SnapshotFormat::BINARY, .generations = 0};
+        model::Save(game, filename, options);
+        SnapshotPayload payload = ReadSnapshotFilePayload(filename);
+        std::string data(payload.data);
+        const uint64_t bad_offset = data.size();
+        std::memcpy(data.data() + sizeof(SnapshotBlockIndex), &bad_offset, sizeof(bad_offset));
+        WriteSnapshotFileAtomically(filename, data, *payload.format, 0);
+
+        model::Game loaded_game = make_loaded_game();
+        CHECK_THROWS(model::Restore(loaded_game, filename, options));
+    }
+}
+
+namespace {
+
+// Игра, из которой записаны снимки tests/snapshots/v0_*: три игрока и четыре предмета на карте map1
+void CheckCorpusGame(const model::Game& game, bool with_delta) {
+    REQUIRE(game.GetSessions().size() == 1);
+    const auto& [session, players_tokens] = *game.GetSessions().begin();
+    CHECK(session->GetSizeLootObjects() == (with_delta ? 5 : 4));
+    for(int id = 1; id <= 4; ++id) {
+        REQUIRE(session->GetLootObjects().contains(id));
+        const auto& loot_object = session->GetLootObjects().at(id);
+        CHECK(loot_object->GetValue() == 10 * id);
+        CHECK(loot_object->GetPosition().x == 4. + id);
+    }
+
+    REQUIRE(players_tokens.GetTokenToPlayerMap().size() == 3);
+    for(int i = 0; i < 3; ++i) {
+        std::shared_ptr<const model::Player> player = game.FindPlayer(model::Token{std::string(31, 'a') + std::to_string(i)});
+        REQUIRE(player);
+        CHECK(player->GetId() == i + 1);
+        CHECK(player->GetName() == "player" + std::to_string(i));
+        const model::Dog& dog = *player->GetDog();
+        CHECK(dog.GetId() == i + 1);
+        CHECK(dog.GetPosition().x == 2.5 * i);
+        CHECK(dog.GetScore() == 10 * i + (with_delta && i == 0 ? 5 : 0));
+        CHECK(dog.GetBag().loot_objects.size() == (i == 2 ? 1u : 0u));
+    }
+    CHECK(game.FindPlayer(model::Token{std::string(31, 'a') + "1"})->GetDog()->GetSpeed().x == 3.);
+}
+
+}  // namespace
+
+TEST_CASE("SNAPSHOT SCHEMA MIGRATION", TAG) {
+    const std::filesystem::path corpus = SNAPSHOT_CORPUS_DIR;
+
+    SECTION("version 0 text archive without header") {
+        std::ifstream in(corpus / "v0_archive_text.state");
+        const std::vector<GameSessionReprTmp> game_ses_reprs = ReadSnapshot(in);
+        REQUIRE(game_ses_reprs.size() == 1);
+        // Счётчики, которые версия 0 хранила в каждом объекте, переезжают в сессию
+        const IdCounters& id_counters = game_ses_reprs[0].GetIdCounters();
+        CHECK(id_counters.player == 1);
+        CHECK(id_counters.dog == 5);
+        CHECK(id_counters.loot_object == 6);
+
+        model::Game game;
+        game.AddMap(MakeTestMap());
+        RestoreSession(game, game_ses_reprs[0]);
+        CheckCorpusGame(game, false);
+        CHECK(model::Dog::GetIdCounter() >= 5);
+        CHECK(model::LootObject::GetIdCounter() >= 6);
+    }
+
+    SECTION("version 0 binary session blocks with a delta") {
+        model::Game game;
+        game.AddMap(MakeTestMap());
+        REQUIRE(model::Restore(game, (corpus / "v0_blocks_binary.state").string(), {.generations = 0}));
+        CheckCorpusGame(game, true);
+        CHECK(model::LootObject::GetIdCounter() >= 7);
+    }
+
+    SECTION("current version keeps the counters in the session only") {
+        model::Game game;
+        game.AddMap(MakeTestMap());
+        REQUIRE(model::Restore(game, (corpus / "v0_blocks_binary.state").string(), {.generations = 0}));
+
+        std::vector<GameSessionReprTmp> game_ses_reprs = CollectSessionReprs(game);
+        std::stringstream ss;
+        WriteSnapshot(game_ses_reprs, ss, SnapshotFormat::TEXT);
+        const std::vector<GameSessionReprTmp> loaded_reprs = ReadSnapshot(ss);
+        REQUIRE(loaded_reprs.size() == 1);
+        CHECK(loaded_reprs[0].GetIdCounters().dog == game_ses_reprs[0].GetIdCounters().dog);
+        CHECK(loaded_reprs[0].GetIdCounters().loot_object == game_ses_reprs[0].GetIdCounters().loot_object);
+        CHECK(loaded_reprs[0].GetPlayerRepr()[0].GetLegacyIdCounter() == 0);
+        CHECK(loaded_reprs[0].GetLootsObjectRepr()[0].GetLegacyIdCounter() == 0);
+    }
 }
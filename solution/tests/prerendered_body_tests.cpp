@@ -0,0 +1,74 @@
+#include <string>
+#include <catch2/catch_test_macros.hpp>
+
+#include <boost/iostreams/copy.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+
+#include "../src/http_handler/prerendered_body.h"
+
+using namespace http_handler;
+
+namespace {
+
+std::string Gunzip(const std::string& data) {
+    namespace io = boost::iostreams;
+    std::string result;
+    io::filtering_istream in;
+    in.push(io::gzip_decompressor());
+    in.push(io::array_source(data.data(), data.size()));
+    io::copy(in, io::back_inserter(result));
+    return result;
+}
+
+}  // namespace
+
+SCENARIO("Prerendered bodies") {
+    GIVEN("a short body") {
+        auto prerendered = PrerenderedBody::Make(R"([{"id": "map1", "name": "Map 1"}])");
+        THEN("it is served as is with a strong tag") {
+            CHECK_FALSE(prerendered->gzip);
+            CHECK(prerendered->identity.etag.size() == 18);
+            CHECK(prerendered->identity.etag.front() == '"');
+            CHECK(&prerendered->Select(true) == &prerendered->identity);
+        }
+        THEN("the tag depends only on the content") {
+            CHECK(PrerenderedBody::Make(prerendered->identity.body)->identity.etag == prerendered->identity.etag);
+            CHECK(PrerenderedBody::Make("[]")->identity.etag != prerendered->identity.etag);
+        }
+    }
+
+    GIVEN("a long repetitive body") {
+        std::string body = "[";
+        for(int i = 0; i < 100; ++i) {
+            body += R"({"x0": 0, "y0": 0, "x1": 40},)";
+        }
+        body += "]";
+        auto prerendered = PrerenderedBody::Make(body);
+        THEN("a smaller gzip variant with its own tag is prepared") {
+            REQUIRE(prerendered->gzip);
+            CHECK(prerendered->gzip->body.size() < body.size());
+            CHECK(Gunzip(prerendered->gzip->body) == body);
+            CHECK(prerendered->gzip->etag != prerendered->identity.etag);
+            CHECK(&prerendered->Select(true) == &*prerendered->gzip);
+            CHECK(&prerendered->Select(false) == &prerendered->identity);
+        }
+    }
+}
+
+TEST_CASE("Conditional request headers") {
+    const std::string etag = R"("0123456789abcdef")";
+    CHECK(MatchesIfNoneMatch(etag, etag));
+    CHECK(MatchesIfNoneMatch(R"("other", W/"0123456789abcdef")", etag));
+    CHECK(MatchesIfNoneMatch("*", etag));
+    CHECK_FALSE(MatchesIfNoneMatch(R"("other")", etag));
+    CHECK_FALSE(MatchesIfNoneMatch("", etag));
+
+    CHECK(AcceptsGzip("gzip"));
+    CHECK(AcceptsGzip("deflate, gzip;q=0.8, br"));
+    CHECK(AcceptsGzip("x-gzip"));
+    CHECK_FALSE(AcceptsGzip("deflate, br"));
+    CHECK_FALSE(AcceptsGzip("gzip;q=0"));
+    CHECK_FALSE(AcceptsGzip("gzip; q=0.000"));
+    CHECK_FALSE(AcceptsGzip("gzipx"));
+}
@@ -0,0 +1,112 @@
+#include <memory>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/domain_model/model_game.h"
+
+namespace {
+
+using namespace model;
+
+bool SameRoad(const Road& road, Point start, Point end) {
+    return road.GetStart().x == start.x && road.GetStart().y == start.y && road.GetEnd().x == end.x
+           && road.GetEnd().y == end.y;
+}
+
+Map MakeMap(const std::vector<Road>& roads) {
+    Map map(Map::Id{"roads"}, "Roads");
+    for(const Road& road : roads) {
+        map.AddRoad(road);
+    }
+    map.SetDogSpeed(1.);
+    map.AddRoadIndexes();
+    return map;
+}
+
+// Дороги клетки, на которых лежит точка
+std::vector<Road> RoadsThrough(const Map& map, Point position) {
+    std::vector<Road> roads;
+    for(const Road& road : map.GetRoadsByPosition(position)) {
+        if(road.Contains(position)) {
+            roads.push_back(road);
+        }
+    }
+    return roads;
+}
+
+// Собака идёт вправо из точки start ticks тиков по dt
+double WalkRight(const Map& map, PointDouble start, double dt = 1e6, int ticks = 1) {
+    GameSession session(std::make_shared<Map>(map));
+    auto dog = std::make_shared<Dog>(0);
+    dog->SetPosition(start);
+    dog->SetSpeedValue(1.);
+    session.AddDog(dog);
+    session.SetDogDirection(*dog, "R");
+    for(int i = 0; i < ticks; ++i) {
+        session.UpdateDogsPosition(dt);
+    }
+    return dog->GetPosition().x;
+}
+
+bool SamePosition(const RoadGraph::Movement& movement, PointDouble position, bool stopped) {
+    return movement.position.x == position.x && movement.position.y == position.y && movement.stopped == stopped;
+}
+
+}  // namespace
+
+SCENARIO("Road network") {
+    GIVEN("collinear roads that overlap, touch or stand apart") {
+        const Map map = MakeMap({Road{Road::HORIZONTAL, {0, 0}, 10}, Road{Road::HORIZONTAL, {20, 0}, 10},
+                                 Road{Road::HORIZONTAL, {15, 0}, 30}, Road{Road::HORIZONTAL, {40, 0}, 50},
+                                 Road{Road::VERTICAL, {10, 0}, 10}, Road{Road::VERTICAL, {10, 0}, -5}});
+        const RoadGraph& graph = map.GetRoadGraph();
+
+        THEN("they are merged into segments") {
+            const auto& segments = graph.GetSegments();
+            REQUIRE(segments.size() == 3);
+            CHECK(SameRoad(segments[0], {0, 0}, {30, 0}));
+            CHECK(SameRoad(segments[1], {40, 0}, {50, 0}));
+            CHECK(SameRoad(segments[2], {10, -5}, {10, 10}));
+        }
+        THEN("a lattice point resolves to the segments through it") {
+            CHECK(RoadsThrough(map, {5, 0}).size() == 1);
+            CHECK(RoadsThrough(map, {10, 0}).size() == 2);
+            CHECK(RoadsThrough(map, {10, -5}).size() == 1);
+            CHECK(RoadsThrough(map, {35, 0}).empty());
+            CHECK(RoadsThrough(map, {5, 1}).empty());
+            CHECK(map.GetRoadsByPosition({-1, 0}).empty());
+            CHECK(map.GetRoadsByPosition({60, 0}).empty());
+            REQUIRE(RoadsThrough(map, {45, 0}).size() == 1);
+            CHECK(SameRoad(RoadsThrough(map, {45, 0})[0], {40, 0}, {50, 0}));
+        }
+        THEN("a dog walks through joined roads and stops at a gap") {
+            CHECK(WalkRight(map, {5., 0.}) == 30.4);
+            CHECK(WalkRight(map, {42., 0.}) == 50.4);
+        }
+        THEN("a long tick ends where many short ones do") {
+            CHECK(WalkRight(map, {5., 0.}, 0.25, 200) == 30.4);
+            CHECK(WalkRight(map, {5., 0.}, 0.25, 10) == 7.5);
+        }
+        THEN("the solver moves a point along an axis until the roads end") {
+            CHECK(SamePosition(graph.Move({5., 0.}, {1., 0.}, 2.), {7., 0.}, false));
+            CHECK(SamePosition(graph.Move({5., 0.2}, {-1., 0.}, 1e3), {-0.4, 0.2}, true));
+            CHECK(SamePosition(graph.Move({10.3, 5.}, {0., -2.}, 1e3), {10.3, -5.4}, true));
+            CHECK(SamePosition(graph.Move({10., 5.}, {1., 0.}, 1e3), {10.4, 5.}, true));
+            CHECK(SamePosition(graph.Move({10., 5.}, {0., 0.}, 1e3), {10., 5.}, false));
+            CHECK(SamePosition(graph.Move({35., 0.}, {1., 0.}, 1.), {35., 0.}, true));
+        }
+    }
+
+    GIVEN("a large map with sparse roads") {
+        const Map map = MakeMap({Road{Road::HORIZONTAL, {0, 0}, 100'000}, Road{Road::VERTICAL, {0, 0}, 100'000},
+                                 Road{Road::HORIZONTAL, {0, 100'000}, 100'000}});
+        const RoadGraph& graph = map.GetRoadGraph();
+
+        THEN("cells grow, and a cell still lists the roads through its points") {
+            CHECK(graph.GetCellSize() > 1);
+            CHECK(RoadsThrough(map, {0, 1}).size() == 1);
+            CHECK(RoadsThrough(map, {0, 100'000}).size() == 2);
+            CHECK(WalkRight(map, {5., 0.}) == 100'000.4);
+        }
+    }
+}
@@ -0,0 +1,47 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/http_handler/session_bodies.h"
+#include "../src/serialization/action_journal.h"
+
+#include "test_maps.h"
+
+using namespace http_handler;
+
+SCENARIO("Published session bodies") {
+    model::Game game;
+    game.AddMap(test_maps::MakeTestMap());
+    std::shared_ptr<const model::Map> map = game.FindMap(model::Map::Id{"map1"});
+    auto [player, token] = game.JoinGame(map, "player", false);
+    const model::GameSession& session = *player->GetPlayersSession();
+
+    SessionBodies bodies(game.GetMaps());
+    CHECK_FALSE(bodies.Find(session, SessionBody::STATE));
+
+    GIVEN("a published state body") {
+        bodies.Publish(session, SessionBody::STATE, "state");
+        bodies.Publish(session, SessionBody::PLAYERS, "players");
+        REQUIRE(bodies.Find(session, SessionBody::STATE));
+        CHECK(bodies.Find(session, SessionBody::STATE)->body == "state");
+
+        THEN("a player action makes it stale") {
+            game.ApplyPlayerAction(*player, "R");
+            CHECK_FALSE(bodies.Find(session, SessionBody::STATE));
+            CHECK_FALSE(bodies.Find(session, SessionBody::PLAYERS));
+        }
+
+        THEN("a replayed action record makes it stale") {
+            const std::string filename = "session_bodies_journal.bin";
+            model::RemoveJournalSegments(filename);
+            {
+                model::ActionJournal journal(filename, model::JournalSyncPolicy::ALWAYS, 1, nullptr);
+                journal.Append(model::ActionRecord(player->GetId(), "D"));
+                journal.Flush();
+            }
+            CHECK(bodies.Find(session, SessionBody::STATE));
+
+            CHECK(model::ReplayJournal(game, filename, 1).records == 1);
+            CHECK_FALSE(bodies.Find(session, SessionBody::STATE));
+            model::RemoveJournalSegments(filename);
+        }
+    }
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+
+#include "../src/domain_model/model_env.h"
+
+// Карты, общие для тестов игры, сессий и сериализации
+namespace test_maps {
+
+inline model::LootType MakeLootType(const std::string& name, int value) {
+    model::LootType loot_type;
+    loot_type.name = name;
+    loot_type.value = value;
+    return loot_type;
+}
+
+// Две дороги буквой Г и два типа предметов
+inline model::Map MakeTestMap(const std::string& id = "map1") {
+    model::Map map(model::Map::Id{id}, "Map " + id);
+    map.AddRoad(model::Road{model::Road::HORIZONTAL, {0, 0}, 40});
+    map.AddRoad(model::Road{model::Road::VERTICAL, {40, 0}, 30});
+    map.SetDogSpeed(3.);
+    map.SetBagCapacity(3);
+    map.SetLootTypes({MakeLootType("key", 10), MakeLootType("wallet", 30)});
+    map.AddRoadIndexes();
+    return map;
+}
+
+}  // namespace test_maps
@@ -0,0 +1,38 @@
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/domain_model/model_game.h"
+#include "../src/domain_model/tick_arena.h"
+
+using namespace model;
+
+namespace {
+    const std::string TAG = "[TickArena]";
+}
+
+TEST_CASE("TICK ARENA", TAG) {
+    TickArena arena(1024);
+    const auto fill = [&arena](size_t count) {
+        std::pmr::vector<std::shared_ptr<LootObject>> loot(arena.GetResource());
+        for(size_t i = 0; i < count; ++i) {
+            loot.push_back(nullptr);
+        }
+        return loot.size();
+    };
+
+    CHECK(fill(16) == 16);
+    arena.Reset();
+    CHECK(arena.GetSize() == 1024);
+
+    // Не поместившееся в буфер берётся из кучи, а буфер растёт к следующему тику
+    CHECK(fill(1000) == 1000);
+    arena.Reset();
+    const size_t grown = arena.GetSize();
+    CHECK(grown > 1024);
+    CHECK(fill(1000) == 1000);
+    arena.Reset();
+    CHECK(arena.GetSize() == grown);
+}
@@ -0,0 +1,60 @@
+#include <chrono>
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/ticker.h"
+
+using namespace std::chrono_literals;
+
+SCENARIO("Fixed step schedule") {
+    const FixedStepSchedule::Clock::time_point start{};
+
+    GIVEN("a schedule with a 10ms step and at most 3 steps per wakeup") {
+        FixedStepSchedule schedule(10ms, FixedStep{.max_steps = 3, .merge = true});
+        schedule.Start(start);
+        REQUIRE(schedule.GetDeadline() == start + 10ms);
+
+        WHEN("the handler takes part of the period") {
+            const auto steps = schedule.Advance(start + 14ms);
+            THEN("the next deadline keeps to the schedule") {
+                CHECK(steps.count == 1);
+                CHECK(steps.last_delta == 10ms);
+                CHECK(schedule.GetDeadline() == start + 20ms);
+                CHECK(schedule.GetStats().lag == 4ms);
+                CHECK(schedule.GetStats().overruns == 0);
+            }
+        }
+        WHEN("the ticker falls behind by less than the limit") {
+            const auto steps = schedule.Advance(start + 35ms);
+            THEN("the missed steps are caught up") {
+                CHECK(steps.count == 3);
+                CHECK(steps.last_delta == 10ms);
+                CHECK(schedule.GetDeadline() == start + 40ms);
+                CHECK(schedule.GetStats().overruns == 1);
+                CHECK(schedule.GetStats().skipped_steps == 0);
+            }
+        }
+        WHEN("the ticker falls behind by more than the limit") {
+            const auto steps = schedule.Advance(start + 62ms);
+            THEN("the extra steps are merged into the last one") {
+                CHECK(steps.count == 3);
+                CHECK(steps.last_delta == 40ms);
+                CHECK(schedule.GetDeadline() == start + 70ms);
+                CHECK(schedule.GetStats().steps == 3);
+                CHECK(schedule.GetStats().skipped_steps == 3);
+                CHECK(schedule.GetStats().max_lag == 52ms);
+            }
+        }
+    }
+
+    GIVEN("a schedule that drops extra steps") {
+        FixedStepSchedule schedule(10ms, FixedStep{.max_steps = 2, .merge = false});
+        schedule.Start(start);
+        const auto steps = schedule.Advance(start + 45ms);
+        THEN("game time lags behind the clock instead") {
+            CHECK(steps.count == 2);
+            CHECK(steps.last_delta == 10ms);
+            CHECK(schedule.GetDeadline() == start + 50ms);
+            CHECK(schedule.GetStats().skipped_steps == 2);
+        }
+    }
+}